@@ -0,0 +1,340 @@
+#include "alloc.h"
+#include "json.h"
+
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <new>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+// Everything here can be used by operator new before any constructor in
+// the program has run, so it all has to be constant initialized
+
+static const int maxPhases = 32;
+
+static char phaseNames[maxPhases][32] = { "startup" };
+static int phaseCount = 1;
+static std::mutex phaseMutex;
+
+static std::atomic<uint64_t> phaseAllocationCounts[maxPhases];
+static std::atomic<uint64_t> phaseAllocationBytes[maxPhases];
+static std::atomic<int64_t> phasePeakLive[maxPhases];
+
+static std::atomic<bool> enabled(false);
+static std::atomic<int> globalPhase(0);
+static thread_local int threadPhase = -1;
+
+static std::atomic<int64_t> liveBytes(0);
+static std::atomic<uint64_t> totalCount(0);
+static std::atomic<uint64_t> totalBytes(0);
+static std::atomic<int64_t> totalPeakLive(0);
+
+static thread_local uint64_t threadCount = 0;
+static thread_local uint64_t threadBytes = 0;
+static thread_local uint64_t unitStartCount = 0;
+static thread_local uint64_t unitStartBytes = 0;
+
+static std::vector<AllocationTracker::Unit> *units = nullptr;
+static std::mutex unitMutex;
+
+static void updateMax(std::atomic<int64_t> &max, int64_t value)
+{
+	int64_t current = max.load(std::memory_order_relaxed);
+
+	while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+// Every block starts with a header saying whether it was counted, so blocks
+// allocated before Enable() aren't taken off the live bytes when they're
+// freed. It's as large as malloc's alignment so the rest stays aligned.
+static const size_t headerSize = alignof(std::max_align_t);
+
+// Live bytes are counted with the size malloc actually reserved, which is
+// all that can be found out again when the block is freed
+static size_t blockSize(void *p)
+{
+#if defined(_WIN32)
+	return _msize(p);
+#elif defined(__APPLE__)
+	return malloc_size(p);
+#else
+	return malloc_usable_size(p);
+#endif
+}
+
+static void trackAllocation(void *p, size_t size)
+{
+	int phase = (threadPhase >= 0) ? threadPhase : globalPhase.load(std::memory_order_relaxed);
+	int64_t reserved = blockSize(p);
+	int64_t live = liveBytes.fetch_add(reserved, std::memory_order_relaxed) + reserved;
+
+	phaseAllocationCounts[phase].fetch_add(1, std::memory_order_relaxed);
+	phaseAllocationBytes[phase].fetch_add(size, std::memory_order_relaxed);
+	updateMax(phasePeakLive[phase], live);
+
+	totalCount.fetch_add(1, std::memory_order_relaxed);
+	totalBytes.fetch_add(size, std::memory_order_relaxed);
+	updateMax(totalPeakLive, live);
+
+	threadCount++;
+	threadBytes += size;
+}
+
+static int phaseIndex(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(phaseMutex);
+
+	for (int i = 0; i < phaseCount; i++)
+	{
+		if (name == phaseNames[i])
+			return i;
+	}
+
+	// Phases past the limit are counted with the startup ones
+	if (phaseCount == maxPhases)
+		return 0;
+
+	snprintf(phaseNames[phaseCount], sizeof(phaseNames[phaseCount]), "%s", name.c_str());
+
+	return phaseCount++;
+}
+
+void *operator new(size_t size)
+{
+	unsigned char *block = (unsigned char*)malloc(headerSize + size);
+
+	if (!block)
+		throw std::bad_alloc();
+
+	block[0] = enabled.load(std::memory_order_relaxed);
+
+	if (block[0])
+		trackAllocation(block, size);
+
+	return block + headerSize;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+	if (!p)
+		return;
+
+	unsigned char *block = (unsigned char*)p - headerSize;
+
+	if (block[0])
+		liveBytes.fetch_sub(blockSize(block), std::memory_order_relaxed);
+
+	free(block);
+}
+
+void operator delete[](void *p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+AllocationTracker::Scope::Scope(const char *phase)
+{
+	m_previous = threadPhase;
+
+	if (!enabled)
+		return;
+
+	threadPhase = phaseIndex(phase);
+	updateMax(phasePeakLive[threadPhase], liveBytes);
+}
+
+AllocationTracker::Scope::~Scope()
+{
+	threadPhase = m_previous;
+}
+
+void AllocationTracker::Enable()
+{
+	enabled = true;
+}
+
+bool AllocationTracker::IsEnabled()
+{
+	return enabled;
+}
+
+void AllocationTracker::SetPhase(const std::string &phase)
+{
+	if (!enabled)
+		return;
+
+	int index = phaseIndex(phase);
+
+	updateMax(phasePeakLive[index], liveBytes);
+	globalPhase = index;
+}
+
+void AllocationTracker::BeginUnit()
+{
+	if (!enabled)
+		return;
+
+	unitStartCount = threadCount;
+	unitStartBytes = threadBytes;
+}
+
+void AllocationTracker::EndUnit(const std::string &name)
+{
+	if (!enabled)
+		return;
+
+	Unit unit;
+	unit.name = name;
+	unit.count = threadCount - unitStartCount;
+	unit.bytes = threadBytes - unitStartBytes;
+
+	std::lock_guard<std::mutex> lock(unitMutex);
+
+	if (!units)
+		units = new std::vector<Unit>;
+
+	units->push_back(unit);
+}
+
+AllocationTracker::Counters AllocationTracker::GetTotals()
+{
+	return { totalCount, totalBytes, totalPeakLive };
+}
+
+void AllocationTracker::Print(std::ostream &out, size_t unitCount)
+{
+	char line[192];
+
+	snprintf(line, sizeof(line), "%-24s %14s %16s %16s", "Allocations", "Count", "Bytes", "Peak live bytes");
+	out << line << "\n";
+
+	std::lock_guard<std::mutex> lock(phaseMutex);
+
+	for (int i = 0; i < phaseCount; i++)
+	{
+		snprintf(line, sizeof(line), "%-24s %14llu %16llu %16lld", phaseNames[i], (unsigned long long)phaseAllocationCounts[i],
+			(unsigned long long)phaseAllocationBytes[i], (long long)phasePeakLive[i]);
+		out << line << "\n";
+	}
+
+	snprintf(line, sizeof(line), "%-24s %14llu %16llu %16lld", "total", (unsigned long long)totalCount,
+		(unsigned long long)totalBytes, (long long)totalPeakLive);
+	out << line << "\n";
+
+	std::lock_guard<std::mutex> unitLock(unitMutex);
+
+	if (!units || units->empty() || unitCount == 0)
+	{
+		out.flush();
+		return;
+	}
+
+	std::vector<const Unit*> sorted;
+
+	for (const Unit &unit : *units)
+		sorted.push_back(&unit);
+
+	unitCount = std::min(unitCount, sorted.size());
+
+	std::partial_sort(sorted.begin(), sorted.begin() + unitCount, sorted.end(), [](const Unit *a, const Unit *b) {
+		return a->bytes > b->bytes;
+	});
+
+	out << "\nCompile units allocating the most while converting:\n";
+
+	for (size_t i = 0; i < unitCount; i++)
+	{
+		const Unit &unit = *sorted[i];
+
+		snprintf(line, sizeof(line), "%14llu %16llu  ", (unsigned long long)unit.count, (unsigned long long)unit.bytes);
+		out << line << unit.name << "\n";
+	}
+
+	out.flush();
+}
+
+void AllocationTracker::WriteJson(std::ostream &out)
+{
+	out << "\"allocations\": {\n\t\t\"phases\": [";
+
+	{
+		std::lock_guard<std::mutex> lock(phaseMutex);
+
+		for (int i = 0; i < phaseCount; i++)
+		{
+			out << (i ? ",\n" : "\n") << "\t\t\t{ \"name\": " << jsonString(phaseNames[i]) << ", \"count\": " << phaseAllocationCounts[i] <<
+				", \"bytes\": " << phaseAllocationBytes[i] << ", \"peakLive\": " << phasePeakLive[i] << " }";
+		}
+	}
+
+	out << "\n\t\t],\n\t\t\"units\": [";
+
+	{
+		std::lock_guard<std::mutex> lock(unitMutex);
+
+		if (units)
+		{
+			for (size_t i = 0; i < units->size(); i++)
+			{
+				const Unit &unit = (*units)[i];
+
+				out << (i ? ",\n" : "\n") << "\t\t\t{ \"name\": " << jsonString(unit.name) << ", \"count\": " << unit.count <<
+					", \"bytes\": " << unit.bytes << " }";
+			}
+		}
+	}
+
+	out << "\n\t\t]\n\t}";
+}
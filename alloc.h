@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+// Counts heap allocations made through operator new, for --alloc-stats.
+//
+// The global operator new and delete are replaced for the whole program,
+// but only check a flag until Enable() is called. Only blocks allocated
+// after that count towards the live bytes, so it should be called as early
+// as possible.
+//
+// Allocations are attributed to the phase active on the allocating thread:
+// a thread's own phase set with a Scope if there is one, else the phase the
+// main thread last set with SetPhase. Allocations made on the converting
+// thread between BeginUnit and EndUnit are also attributed to that compile
+// unit. Peak live bytes are those of the whole process while the phase was
+// active; units only get counts, since other threads allocate while they're
+// converted.
+class AllocationTracker
+{
+public:
+	struct Counters
+	{
+		uint64_t count;
+		uint64_t bytes;
+		int64_t peakLive;
+	};
+
+	struct Unit
+	{
+		std::string name;
+		uint64_t count;
+		uint64_t bytes;
+	};
+
+	// Sets the calling thread's phase until the scope ends
+	class Scope
+	{
+	public:
+		Scope(const char *phase);
+		~Scope();
+
+	private:
+		int m_previous;
+	};
+
+	static void Enable();
+	static bool IsEnabled();
+
+	static void SetPhase(const std::string &phase);
+
+	static void BeginUnit();
+	static void EndUnit(const std::string &name);
+
+	// Totals since Enable()
+	static Counters GetTotals();
+
+	static void Print(std::ostream &out, size_t unitCount);
+
+	// Writes the "allocations" member of a JSON object, without a trailing
+	// comma or newline
+	static void WriteJson(std::ostream &out);
+};
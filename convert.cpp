@@ -0,0 +1,1464 @@
+#include "convert.h"
+#include "output.h"
+#include "shard.h"
+#include "alloc.h"
+#include "trace.h"
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+typedef std::map<std::string, std::vector<Cpp::UserType*>> UserTypeNameMap;
+
+std::vector<Cpp::File*> cppFiles;
+TypeRegistry typeRegistry;
+
+int currentCompileUnitIndex = 0;
+
+// Set while running as a pipeline (see runPipeline in main.cpp)
+OutputWriter *pipelineWriter = nullptr;
+std::set<Cpp::File*> dispatchedFiles;
+std::vector<Cpp::File*> modifiedFiles;
+
+// --shard: units belonging to other shards are still converted so that types
+// and member functions shared with this shard's files come out the same, but
+// their variables and function bodies are skipped and they aren't written
+int shard = 0;
+int shardCount = 1;
+bool skipDefinitions = false;
+
+// --types-only: functions and the line table are skipped entirely and only
+// type definitions are written
+bool typesOnly = false;
+
+// --cu / --type. Compile units that don't match aren't decoded. With type
+// patterns, only matching types, the types they depend on and their member
+// functions are converted, and only type definitions are written.
+SymbolFilter filter;
+
+// Every compile unit readCompileUnits has seen, in section order. When
+// filtering, types in units that were skipped or only partly converted are
+// converted on demand through these.
+struct CompileUnit
+{
+	int index; // of the compile unit entry
+	int end;   // index of the first entry after the unit's children
+	bool prepared;
+	Cpp::File *file;
+	std::map<int, std::string> typeNames; // final names, by entry index
+};
+
+std::vector<CompileUnit*> compileUnits;
+std::mutex compileUnitMutex;
+
+// Entry index of every type, used to keep files in section order when types
+// are converted on demand
+std::map<Cpp::UserType*, int> userTypeEntries;
+
+Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename);
+const char* compileUnitName(Dwarf::Entry *entry);
+void fixUserTypeNames(UserTypeNameMap &nameUTListPairs);
+std::string fixedTypeName(const std::string &name, size_t i, size_t count);
+void beforeModifyingFile(Cpp::File *cpp);
+bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp);
+bool processFilteredCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp);
+CompileUnit* findCompileUnit(int entryIndex);
+bool prepareCompileUnit(Dwarf *dwarf, CompileUnit *unit, Cpp::File *cpp);
+Cpp::UserType* materializeUserType(Dwarf::Entry *entry);
+Cpp::UserType* findMethodOwner(Dwarf::Entry *entry);
+bool isUserTypeTag(Elf32_Half tag);
+bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var);
+bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type);
+bool processLocationAttr(Dwarf::Attribute *attr, int *location);
+bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u);
+bool processUserType(Dwarf::Entry *entry, Cpp::UserType *u);
+bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c);
+bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m);
+bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_);
+bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e);
+bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size);
+bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f);
+bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p);
+bool processFunction(Dwarf::Entry *entry, Cpp::Function *f);
+bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f);
+bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a);
+bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a);
+void replaceChar(char *str, char ch, char newCh);
+
+static inline std::string toHexString(int x)
+{
+	std::stringstream ss;
+	ss << std::hex << std::showbase << x;
+	return ss.str();
+}
+
+bool error(std::string errorMessage) {
+	std::cout << "ERROR: " << errorMessage << std::endl;
+	return false;
+}
+
+Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename)
+{
+	*outFilename = nullptr;
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		if (attr->name == DW_AT_name)
+		{
+			*outFilename = attr->getString();
+			break;
+		}
+	}
+
+	if (*outFilename)
+	{
+		for (Cpp::File *cpp : cppFiles)
+		{
+			if (cpp->filename == *outFilename)
+				return cpp;
+		}
+	}
+
+	return nullptr;
+}
+
+const char* compileUnitName(Dwarf::Entry *entry)
+{
+	for (Dwarf::Attribute &attr : entry->attributes)
+	{
+		if (attr.name == DW_AT_name)
+			return attr.getString();
+	}
+
+	return "";
+}
+
+// Called before anything is added to a file that may already have been
+// handed to the writer by the pipeline. Files outside the shard count as
+// handed over too, since written files can refer to their types. Waits until
+// the writer is no longer reading it, and has its caches filled and the file
+// written again once the current unit is done.
+void beforeModifyingFile(Cpp::File *cpp)
+{
+	if (!pipelineWriter)
+		return;
+
+	if (dispatchedFiles.erase(cpp))
+		pipelineWriter->wait();
+
+	if (std::find(modifiedFiles.begin(), modifiedFiles.end(), cpp) == modifiedFiles.end())
+		modifiedFiles.push_back(cpp);
+}
+
+bool isInShard(Cpp::File *cpp)
+{
+	return shardCount == 1 || ShardIndex::Select(cpp->filename, shardCount) == shard;
+}
+
+void fixUserTypeNames(UserTypeNameMap &nameUTListPairs)
+{
+	for (auto const &x : nameUTListPairs)
+	{
+		for (size_t i = 0; i < x.second.size(); i++)
+			x.second[i]->name = fixedTypeName(x.first, i, x.second.size());
+	}
+
+	// Cached array/function declarators may contain the old names
+	for (auto const &x : nameUTListPairs)
+		for (Cpp::UserType *ut : x.second)
+			ut->nameCached = false;
+}
+
+// Name of the i-th of count types in a compile unit that share a name
+std::string fixedTypeName(const std::string &name, size_t i, size_t count)
+{
+	std::string fixed = name.empty() ? "type" : name;
+
+	if (count > 1)
+		fixed += "_" + std::to_string(i);
+
+	return fixed;
+}
+
+// Reads all the DWARF data up front, for everything but the pipeline
+Dwarf* loadDwarf(ElfFile *elf)
+{
+	std::cout << "Loading DWARFv1 information..." << std::endl;
+
+	Dwarf *dwarf;
+
+	{
+		Trace::Span span("index .debug");
+		dwarf = new Dwarf(elf, false);
+	}
+
+	if (!dwarf->getError())
+		readCompileUnits(dwarf, nullptr);
+
+	// --types-only has no use for the line table
+	if (!dwarf->getError() && !typesOnly)
+	{
+		Trace::Span span("read .line");
+		dwarf->readLines();
+	}
+
+	if (dwarf->getError()) {
+		std::cout << "Failed to parse DWARF data. Error Code: " << dwarf->getError() << std::endl;
+		return nullptr;
+	}
+
+	return dwarf;
+}
+
+// Reads the top level entries and the children of every compile unit that
+// passes the --cu filter; the children of other units are only skipped over.
+// Units to convert are handed to the converter through units, if given.
+void readCompileUnits(Dwarf *dwarf, BoundedQueue<int> *units)
+{
+	Trace::Span span("read .debug");
+
+	Elf32_Off offset = 0;
+	Elf32_Off size = dwarf->getSectionSize();
+	int pending = -1;
+
+	while (offset < size && !dwarf->getError())
+	{
+		int index;
+		offset = dwarf->readEntry(offset, &index);
+
+		if (dwarf->getError())
+			break;
+
+		// A unit is only handed over once the entry after it has been read,
+		// since the converter uses that entry to find where the unit ends
+		if (pending != -1)
+		{
+			if (units)
+				units->push(pending);
+
+			pending = -1;
+		}
+
+		Dwarf::Entry *entry = &dwarf->entries[index];
+
+		if (entry->tag != DW_TAG_compile_unit)
+			continue;
+
+		// Read the unit's children up to its sibling. Without a usable
+		// sibling the entries that follow are treated as top level ones,
+		// same as Entry::getSibling does.
+		Elf32_Off end = offset;
+
+		for (Dwarf::Attribute &attr : entry->attributes)
+		{
+			if (attr.name == DW_AT_sibling)
+			{
+				Elf32_Off sibling = attr.getReference();
+
+				if (sibling > offset && dwarf->hasEntryAt(sibling))
+					end = sibling;
+
+				break;
+			}
+		}
+
+		bool matches = filter.matchesUnit(compileUnitName(entry));
+
+		{
+			Trace::Span unitSpan(matches ? "read unit" : "skip unit", compileUnitName(entry));
+
+			if (matches)
+				offset = dwarf->readEntries(offset, end);
+			else
+				offset = dwarf->skipEntries(offset, end);
+		}
+
+		CompileUnit *unit = new CompileUnit;
+		unit->index = index;
+		unit->end = dwarf->entries.size();
+		unit->prepared = false;
+		unit->file = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(compileUnitMutex);
+			compileUnits.push_back(unit);
+		}
+
+		if (matches)
+			pending = index;
+	}
+
+	if (pending != -1 && units)
+		units->push(pending);
+
+	if (units)
+		units->close();
+}
+
+bool processDwarf(Dwarf *dwarf)
+{
+	typeRegistry.reset(dwarf->getEntryCount());
+
+	Dwarf::Entry *entry = &dwarf->entries.front();
+
+	while (entry)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_compile_unit:
+		{
+			// The children of units the filter rejects were only skipped over
+			if (!filter.matchesUnit(compileUnitName(entry)))
+				break;
+
+			if (!convertCompileUnit(entry))
+				return false;
+
+			break;
+		}
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+void resetConverter()
+{
+	cppFiles.clear();
+	dispatchedFiles.clear();
+	modifiedFiles.clear();
+	userTypeEntries.clear();
+
+	for (CompileUnit *unit : compileUnits)
+		delete unit;
+
+	compileUnits.clear();
+}
+
+void freeModel()
+{
+	for (Cpp::File *cpp : cppFiles)
+	{
+		for (Cpp::UserType *userType : cpp->userTypes)
+		{
+			switch (userType->type)
+			{
+			case Cpp::UserType::CLASS:
+			case Cpp::UserType::UNION:
+			case Cpp::UserType::STRUCT:
+				delete userType->classData;
+				break;
+			case Cpp::UserType::ENUM:
+				delete userType->enumData;
+				break;
+			case Cpp::UserType::ARRAY:
+				delete userType->arrayData;
+				break;
+			case Cpp::UserType::FUNCTION:
+				delete userType->functionData;
+				break;
+			}
+
+			delete userType;
+		}
+
+		delete cpp;
+	}
+
+	cppFiles.clear();
+
+	// It only points into the freed types
+	typeRegistry.reset(0);
+}
+
+// Returns the file the unit was converted into, or nullptr on failure
+Cpp::File* convertCompileUnit(Dwarf::Entry *entry)
+{
+	AllocationTracker::BeginUnit();
+	Trace::Span span("convert unit", compileUnitName(entry));
+
+	const char *filename;
+	Cpp::File *cpp = findCppFile(entry, &filename);
+
+	bool found = (cpp != nullptr);
+
+	if (!found)
+	{
+		cpp = new Cpp::File;
+		cpp->filename = filename;
+	}
+	else
+		beforeModifyingFile(cpp);
+
+	skipDefinitions = typesOnly || !isInShard(cpp) || filter.hasTypePatterns();
+
+	bool processed = filter.hasTypePatterns() ? processFilteredCompileUnit(entry, cpp) : processCompileUnit(entry, cpp);
+
+	if (!processed)
+	{
+		error(std::string("Failed to processCompileUnit for '").append(cpp->filename).append("'"));
+		return nullptr;
+	}
+
+	if (!found)
+		cppFiles.push_back(cpp);
+
+	AllocationTracker::EndUnit(cpp->filename);
+
+	//std::cout << "Found compile unit " << cpp->filename << std::endl;
+	//std::cout << "\t" << std::to_string(cpp->userTypes.size()) << " user types" << std::endl;
+	//std::cout << "\t" << std::to_string(cpp->variables.size()) << " variables" << std::endl;
+
+	return cpp;
+}
+
+bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp)
+{
+	// Duplicate names only get disambiguated within a compile unit
+	UserTypeNameMap nameUTListPairs;
+	std::vector<std::pair<int, Cpp::UserType*>> unitTypes;
+
+	Dwarf::Entry *next = entry->getSibling();
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			cpp->filename = attr->getString();
+			break;
+		}
+	}
+
+	Dwarf::Entry *start = ++entry;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_class_type:
+		case DW_TAG_structure_type:
+		case DW_TAG_enumeration_type:
+		case DW_TAG_array_type:
+		case DW_TAG_subroutine_type:
+		case DW_TAG_union_type:
+		{
+			Cpp::UserType *userType = new Cpp::UserType;
+			userType->file = cpp;
+			typeRegistry.insert(entry->index, userType);
+
+			if (filter.isActive())
+				userTypeEntries[userType] = entry->index;
+		}
+		}
+
+		entry = entry->getSibling();
+	}
+
+	entry = start;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_global_variable:
+		case DW_TAG_local_variable:
+		{
+			if (skipDefinitions)
+				break;
+
+			Cpp::Variable var;
+
+			if (!processVariable(entry, &var))
+				return error("Failed to processVar.");
+
+			cpp->variables.push_back(var);
+			break;
+		}
+		case DW_TAG_class_type:
+		case DW_TAG_structure_type:
+		case DW_TAG_enumeration_type:
+		case DW_TAG_array_type:
+		case DW_TAG_subroutine_type:
+		case DW_TAG_union_type:
+		{
+			Cpp::UserType *userType = typeRegistry.find(entry->index);
+			processUserType(entry, userType);
+
+			userType->index = cpp->userTypes.size();
+			cpp->userTypes.push_back(userType);
+
+			nameUTListPairs[userType->name].push_back(userType);
+			unitTypes.emplace_back(entry->index, userType);
+			break;
+		}
+		case DW_TAG_global_subroutine:
+		case DW_TAG_subroutine:
+		case DW_TAG_inlined_subroutine:
+		{
+			// Skipped along with everything nested in it
+			if (typesOnly)
+				break;
+
+			Cpp::Function f;
+			f.dwarf = entry->dwarf;
+
+			if (!processFunctionType(entry, &f))
+				return error("Failed to processFunctionType.");
+
+			if (!processFunction(entry, &f))
+				return error("Failed to processFunction.");
+
+			if (!skipDefinitions)
+				cpp->functions.push_back(f);
+		}
+		}
+
+		entry = entry->getSibling();
+	}
+
+	{
+		AllocationTracker::Scope scope("dedupe");
+
+		fixUserTypeNames(nameUTListPairs);
+
+		for (auto const &x : unitTypes)
+			typeRegistry.insertName(x.second->name, x.first, x.second);
+	}
+
+	return true;
+}
+
+// Used instead of processCompileUnit when there are type patterns. Only the
+// unit's types that match (and what they depend on) are converted, along
+// with the declarations of their member functions.
+bool processFilteredCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp)
+{
+	Dwarf *dwarf = entry->dwarf;
+	CompileUnit *unit = findCompileUnit(entry->index);
+
+	if (!unit || !prepareCompileUnit(dwarf, unit, cpp))
+		return error("Failed to prepare compile unit.");
+
+	for (auto const &x : unit->typeNames)
+	{
+		if (filter.matchesType(x.second) && !materializeUserType(&dwarf->entries[x.first]))
+			return false;
+	}
+
+	Dwarf::Entry *next = &dwarf->entries[unit->end - 1] + 1;
+
+	for (entry = entry + 1; entry && entry < next; entry = entry->getSibling())
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_global_subroutine:
+		case DW_TAG_subroutine:
+		case DW_TAG_inlined_subroutine:
+		{
+			if (!findMethodOwner(entry))
+				break;
+
+			Cpp::Function f;
+			f.dwarf = entry->dwarf;
+
+			if (!processFunctionType(entry, &f))
+				return error("Failed to processFunctionType.");
+
+			if (!processFunction(entry, &f))
+				return error("Failed to processFunction.");
+		}
+		}
+	}
+
+	return true;
+}
+
+CompileUnit* findCompileUnit(int entryIndex)
+{
+	std::lock_guard<std::mutex> lock(compileUnitMutex);
+
+	auto it = std::upper_bound(compileUnits.begin(), compileUnits.end(), entryIndex, [](int index, CompileUnit *unit) {
+		return index < unit->index;
+	});
+
+	if (it == compileUnits.begin())
+		return nullptr;
+
+	CompileUnit *unit = *(it - 1);
+
+	return (entryIndex < unit->end) ? unit : nullptr;
+}
+
+// Decodes the unit's entries if they were skipped, works out the final names
+// of its types the same way fixUserTypeNames does, and finds the file its
+// types go into (cpp, or a file found or created from the unit's name)
+bool prepareCompileUnit(Dwarf *dwarf, CompileUnit *unit, Cpp::File *cpp)
+{
+	if (unit->prepared)
+		return true;
+
+	if (!dwarf->decodeEntries(unit->index + 1, unit->end))
+		return false;
+
+	Dwarf::Entry *entry = &dwarf->entries[unit->index];
+
+	if (!cpp)
+	{
+		const char *filename;
+		cpp = findCppFile(entry, &filename);
+
+		if (!cpp)
+		{
+			cpp = new Cpp::File;
+			cpp->filename = filename;
+			cppFiles.push_back(cpp);
+
+			// Has to be written by the pipeline as well
+			modifiedFiles.push_back(cpp);
+		}
+	}
+
+	Dwarf::Entry *next = &dwarf->entries[unit->end - 1] + 1;
+	std::map<std::string, std::vector<int>> nameEntries;
+
+	for (entry = entry + 1; entry && entry < next; entry = entry->getSibling())
+	{
+		if (!isUserTypeTag(entry->tag))
+			continue;
+
+		std::string name;
+
+		for (Dwarf::Attribute &attr : entry->attributes)
+		{
+			if (attr.name == DW_AT_name)
+			{
+				// processUserType does the same to the name in place
+				char *str = attr.getString();
+				replaceChar(str, '@', '_');
+				name = str;
+				break;
+			}
+		}
+
+		nameEntries[name].push_back(entry->index);
+	}
+
+	for (auto const &x : nameEntries)
+	{
+		for (size_t i = 0; i < x.second.size(); i++)
+			unit->typeNames[x.second[i]] = fixedTypeName(x.first, i, x.second.size());
+	}
+
+	unit->file = cpp;
+	unit->prepared = true;
+
+	return true;
+}
+
+// Converts the type at entry and everything it refers to, adding it to its
+// unit's file
+Cpp::UserType* materializeUserType(Dwarf::Entry *entry)
+{
+	Cpp::UserType *userType = typeRegistry.find(entry->index);
+
+	if (userType)
+		return userType;
+
+	Dwarf *dwarf = entry->dwarf;
+	CompileUnit *unit = findCompileUnit(entry->index);
+
+	if (!unit)
+		return nullptr;
+
+	// Without type patterns, units that pass the --cu filter are converted
+	// in full by processCompileUnit and nothing in them is done on demand
+	Dwarf::Entry *unitEntry = &dwarf->entries[unit->index];
+
+	if (!filter.hasTypePatterns() && filter.matchesUnit(compileUnitName(unitEntry)))
+		return nullptr;
+
+	if (!prepareCompileUnit(dwarf, unit, nullptr) || !isUserTypeTag(entry->tag))
+		return nullptr;
+
+	userType = new Cpp::UserType;
+	userType->file = unit->file;
+	userTypeEntries[userType] = entry->index;
+
+	// Registered first so types that refer back to it find it
+	typeRegistry.insert(entry->index, userType);
+
+	if (!processUserType(entry, userType))
+		return nullptr;
+
+	userType->name = unit->typeNames[entry->index];
+	userType->nameCached = false;
+
+	beforeModifyingFile(unit->file);
+	unit->file->userTypes.push_back(userType);
+
+	return userType;
+}
+
+// Returns the already converted type the function is a member of, if any
+Cpp::UserType* findMethodOwner(Dwarf::Entry *entry)
+{
+	Dwarf *dwarf = entry->dwarf;
+	Dwarf::Entry *next = entry->getSibling();
+
+	for (entry = entry + 1; entry && entry < next; entry = entry->getSibling())
+	{
+		if (entry->tag != DW_TAG_formal_parameter)
+			continue;
+
+		bool isThis = false;
+		Elf32_Off ref = 0;
+
+		for (Dwarf::Attribute &attr : entry->attributes)
+		{
+			switch (attr.name)
+			{
+			case DW_AT_name:
+				isThis = (strcmp(attr.getString(), "this") == 0);
+				break;
+			case DW_AT_user_def_type:
+				ref = attr.getReference();
+				break;
+			case DW_AT_mod_u_d_type:
+				ref = dwarf->read<Elf32_Off>(attr.getBlock() + attr.size - sizeof(Elf32_Off));
+				break;
+			}
+		}
+
+		Dwarf::Entry *owner = isThis ? dwarf->getEntryFromReference(ref) : nullptr;
+
+		return owner ? typeRegistry.find(owner->index) : nullptr;
+	}
+
+	return nullptr;
+}
+
+bool isUserTypeTag(Elf32_Half tag)
+{
+	switch (tag)
+	{
+	case DW_TAG_class_type:
+	case DW_TAG_structure_type:
+	case DW_TAG_enumeration_type:
+	case DW_TAG_array_type:
+	case DW_TAG_subroutine_type:
+	case DW_TAG_union_type:
+		return true;
+	}
+
+	return false;
+}
+
+bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var)
+{
+	var->isGlobal = (entry->tag == DW_TAG_global_variable);
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			var->name = attr->getString();
+			break;
+		case DW_AT_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_mod_u_d_type:
+			if (!processTypeAttr(attr, &var->type))
+				return error(std::string("Failed to processTypeAttr for variable '").append(var->name).append("'."));
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type)
+{
+	Dwarf *dwarf = attr->dwarf;
+
+	switch (attr->name)
+	{
+	case DW_AT_fund_type:
+	{
+		type->isFundamentalType = true;
+		type->fundamentalType = (Cpp::FundamentalType)attr->getHword();
+		break;
+	}
+	case DW_AT_user_def_type:
+	{
+		type->isFundamentalType = false;
+
+		if (!findUserType(dwarf, attr->getReference(), &type->userType))
+			return error(std::string("processTypeAttr failed when handling AT_user_def_type."));
+
+		break;
+	}
+	case DW_AT_mod_fund_type:
+	{
+		type->isFundamentalType = true;
+
+		char *mod = attr->getBlock();
+		char *end = mod + attr->size - sizeof(Elf32_Half);
+
+		type->fundamentalType = (Cpp::FundamentalType)dwarf->read<Elf32_Half>(end);
+
+		while (mod < end)
+		{
+			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
+			mod++;
+		}
+
+		break;
+	}
+	case DW_AT_mod_u_d_type:
+	{
+		type->isFundamentalType = false;
+
+		char *mod = attr->getBlock();
+		char *end = mod + attr->size - sizeof(Elf32_Off);
+
+		if (!findUserType(dwarf, dwarf->read<Elf32_Off>(end), &type->userType))
+			return error(std::string("processTypeAttr failed when handling AT_mod_u_d_type."));
+
+		while (mod < end)
+		{
+			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
+			mod++;
+		}
+
+		break;
+	}
+	}
+
+	return true;
+}
+
+bool processLocationAttr(Dwarf::Attribute *attr, int *location)
+{
+	// I don't really know how location is supposed to be handled,
+	// so I just look for a DW_OP_CONST and use that as the "location"
+
+	Dwarf *dwarf = attr->dwarf;
+
+	char *block = attr->getBlock();
+	char *end = block + attr->size;
+
+	while (block < end)
+	{
+		char op = dwarf->read<char>(block);
+		block += sizeof(char);
+
+		if (op == DW_OP_CONST)
+		{
+			*location = dwarf->read<Elf32_Word>(block);
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u)
+{
+	Dwarf::Entry *entry = dwarf->getEntryFromReference(ref);
+
+	*u = entry ? typeRegistry.find(entry->index) : nullptr;
+
+	// Types in units the filters skipped are converted when first needed
+	if (!*u && entry && filter.isActive())
+		*u = materializeUserType(entry);
+
+	if (!*u)
+		return error(std::string("Failed to findUserType for reference '").append(std::to_string(ref)).append("'."));
+
+	return true;
+}
+
+bool processUserType(Dwarf::Entry *entry, Cpp::UserType *userType)
+{
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+		{
+			char *name = attr->getString();
+			replaceChar(name, '@', '_');
+			userType->name = name;
+			break;
+		}
+		}
+	}
+
+	switch (entry->tag)
+	{
+	case DW_TAG_class_type:
+	case DW_TAG_structure_type:
+	case DW_TAG_union_type:
+		userType->type = (entry->tag == DW_TAG_structure_type) ? Cpp::UserType::STRUCT : ((entry->tag == DW_TAG_union_type) ? Cpp::UserType::UNION : Cpp::UserType::CLASS);
+		userType->classData = new Cpp::ClassType;
+		userType->classData->parent = userType;
+
+		if (!processClassType(entry, userType->classData))
+			return error(std::string("Failed to processClassType for user type '").append(userType->name).append("'."));
+
+		break;
+	case DW_TAG_enumeration_type:
+		userType->type = Cpp::UserType::ENUM;
+		userType->enumData = new Cpp::EnumType;
+
+		if (!processEnumType(entry, userType->enumData))
+			return error(std::string("Failed to processEnumType for user type '").append(userType->name).append("'."));
+
+		break;
+	case DW_TAG_array_type:
+		userType->type = Cpp::UserType::ARRAY;
+		userType->arrayData = new Cpp::ArrayType;
+
+		if (!processArrayType(entry, userType->arrayData))
+			return error(std::string("Failed to processArrayType for array type '").append(userType->name).append("'."));
+
+		break;
+	case DW_TAG_subroutine_type:
+		userType->type = Cpp::UserType::FUNCTION;
+		userType->functionData = new Cpp::FunctionType;
+
+		if (!processFunctionType(entry, userType->functionData))
+			return error(std::string("Failed to processFunctionType for function type '").append(userType->name).append("'."));
+
+		break;
+	}
+
+	return true;
+}
+
+bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c)
+{
+	c->size = 0;
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_byte_size:
+			c->size = attr->getWord();
+			break;
+		}
+	}
+
+	Dwarf::Entry *next = entry->getSibling();
+	Dwarf::Entry *first = entry;
+
+	int memberCount = 0;
+	entry++;
+
+	while (entry && entry < next)
+	{
+		if (entry->tag == DW_TAG_member)
+			memberCount++;
+
+		entry = entry->getSibling();
+	}
+
+	c->members.reserve(memberCount);
+	entry = first + 1;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_member:
+		{
+			Cpp::ClassType::Member m;
+
+			if (!processMember(entry, &m))
+				return error("Failed to processMember for class type.");
+
+			c->members.push_back(m);
+			break;
+		}
+		case DW_TAG_inheritance:
+			Cpp::ClassType::Inheritance i;
+
+			if (!processInheritance(entry, &i))
+				return error("Failed to processInheritance for class type.");
+
+			c->inheritances.push_back(i);
+			break;
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m)
+{
+	m->bit_offset = -1;
+	m->bit_size = -1;
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			m->name = attr->getString();
+			break;
+		case DW_AT_bit_offset:
+			m->bit_offset = attr->getHword();
+			break;
+		case DW_AT_bit_size:
+			m->bit_size = attr->getWord();
+			break;
+		case DW_AT_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_mod_u_d_type:
+			if (!processTypeAttr(attr, &m->type))
+				return error(std::string("Failed to processTypeAttr for member '").append(m->name).append("'."));
+			break;
+		case DW_AT_location:
+			if (!processLocationAttr(attr, &m->offset))
+				return error(std::string("Failed to processLocationAttr for member '").append(m->name).append("'."));
+		}
+	}
+
+	return true;
+}
+
+bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_)
+{
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_user_def_type:
+			if (!processTypeAttr(attr, &i_->type))
+				return error("Failed to processTypeAttr for inheritance.");
+			break;
+		case DW_AT_location:
+			if (!processLocationAttr(attr, &i_->offset))
+				return error("Failed to processLocationAttr for inheritance.");
+		}
+	}
+
+	return true;
+}
+
+bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e)
+{
+	int byte_size = 0;
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_byte_size:
+			byte_size = attr->getWord();
+
+			switch (byte_size) {
+			case 1:
+				e->baseType = Cpp::FundamentalType::UNSIGNED_CHAR;
+				break;
+			case 2:
+				e->baseType = Cpp::FundamentalType::UNSIGNED_SHORT;
+				break;
+			case 4:
+				e->baseType = Cpp::FundamentalType::INT;
+				break;
+			case 8:
+				e->baseType = Cpp::FundamentalType::LONG;
+				break;
+			default:
+				return error(std::string("Unknown enum base type size for enum type. (Size: ").append(std::to_string(byte_size)).append(")"));
+				break;
+			}
+			break;
+		case DW_AT_element_list:
+			if (!processElementList(attr, e, byte_size))
+				return error("Failed to processElementList for enum type.");
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size)
+{
+	Dwarf *dwarf = attr->dwarf;
+
+	char *block = attr->getBlock();
+	char *end = block + attr->size;
+
+	while (block < end)
+	{
+		Cpp::EnumType::Element element;
+
+		if (byte_size == 1) {
+			element.constValue = dwarf->read<unsigned char>(block);
+		}
+		else if (byte_size == 2) {
+			element.constValue = dwarf->read<unsigned short>(block);
+		}
+		else if (byte_size == 4) {
+			element.constValue = dwarf->read<int>(block);
+		}
+		else if (byte_size == 8) {
+			element.constValue = dwarf->read<long>(block);
+		}
+		
+		block += byte_size;
+
+		element.name = block;
+		block += element.name.size() + 1;
+
+		e->elements.push_back(element);
+	}
+
+	return true;
+}
+
+bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f)
+{
+	Dwarf::Entry *next = entry->getSibling();
+	Dwarf::Entry *first = entry;
+
+	int paramCount = 0;
+	entry++;
+
+	while (entry && entry < next)
+	{
+		if (entry->tag == DW_TAG_formal_parameter)
+			paramCount++;
+
+		entry = entry->getSibling();
+	}
+
+	f->parameters.reserve(paramCount);
+	entry = first;
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_mod_u_d_type:
+			if (!processTypeAttr(attr, &f->returnType))
+				return error("Failed to processTypeAttr for function return type.");
+			break;
+		}
+	}
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_formal_parameter:
+			Cpp::FunctionType::Parameter p;
+
+			if (!processParameter(entry, &p))
+				return error("Failed to processParameter for function parameter.");
+
+			f->parameters.push_back(p);
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p)
+{
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			p->name = attr->getString();
+			break;
+		case DW_AT_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_mod_u_d_type:
+			if (!processTypeAttr(attr, &p->type))
+				return error(std::string("Failed to processTypeAttr for parameter '").append(p->name).append("'."));
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool processFunction(Dwarf::Entry *entry, Cpp::Function *f)
+{
+	f->isGlobal = (entry->tag == DW_TAG_global_subroutine);
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			f->name = attr->getString();
+			break;
+		case DW_AT_mangled_name:
+			f->mangledName = attr->getString();
+			break;
+		case DW_AT_low_pc:
+			f->startAddress = attr->getAddress();
+			break;
+		}
+	}
+
+	Dwarf::Entry *next = entry->getSibling();
+
+	entry++;
+
+	while (entry && entry < next && !skipDefinitions)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_lexical_block:
+			if (!processLexicalBlock(entry, f))
+				return error(std::string("Failed to processLexicalBlock for function '").append(f->name).append("'."));
+		}
+
+		entry = entry->getSibling();
+	}
+
+	f->typeOwner = nullptr;
+	if (f->parameters.size() > 0 && f->parameters[0].name.compare("this") == 0) {
+		f->typeOwner = f->parameters[0].type.userType;
+		f->parameters.erase(f->parameters.begin());
+		beforeModifyingFile(f->typeOwner->file);
+		f->typeOwner->classData->functions.push_back(*f);
+	}
+	else if (f->mangledName.size() > 2) {
+		int foundAt = f->mangledName.rfind("__");
+		if (foundAt != -1) {
+			char temp;
+			std::stringstream length;
+			int i;
+			for (i = foundAt + 1; i < f->mangledName.size(); i++) {
+				temp = f->mangledName[i];
+				if (temp >= '0' && temp <= '9') {
+					length << temp;
+				}
+				else {
+					break;
+				}
+			}
+
+			std::string lengthStr = length.str();
+			if (lengthStr.length() > 0) {
+				int lengthCount = std::stoi(lengthStr);
+				if (f->mangledName[i + lengthCount] == 'F') {
+					std::string className = f->mangledName.substr(i, lengthCount);
+
+					// Only finds types from compile units that are done converting,
+					// under their final (disambiguated) names
+					Cpp::UserType* type = typeRegistry.findByName(className);
+
+					if (type != nullptr) {
+						f->typeOwner = type;
+						beforeModifyingFile(f->typeOwner->file);
+						f->typeOwner->classData->functions.push_back(*f);
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f)
+{
+	Dwarf::Entry *next = entry->getSibling();
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_global_variable:
+		case DW_TAG_local_variable:
+		{
+			Cpp::Variable v;
+			
+			if (!processVariable(entry, &v))
+				return error(std::string("Failed to processVariable for local var lexical block in function '").append(f->name).append("'."));
+
+			f->variables.push_back(v);
+			break;
+		}
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a)
+{
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_ordering:
+			if (attr->getHword() != DW_ORD_row_major) // meh
+				return error(std::string("processArrayType encountered ordering unsupported by dwarf2cpp! (").append(toHexString(attr->getHword())).append(")"));
+			break;
+		case DW_AT_subscr_data:
+			if (!processSubscriptData(attr, a))
+				return error("Failed to processSubscriptData.");
+		}
+	}
+
+	return true;
+}
+
+bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a)
+{
+	Dwarf *dwarf = attr->dwarf;
+
+	char *block = attr->getBlock();
+	char *end = block + attr->size;
+
+	while (block < end)
+	{
+		char format = dwarf->read<char>(block);
+		block += sizeof(char);
+
+		if (format == DW_FMT_ET)
+		{
+			int typeAttrIndex;
+			Dwarf::Attribute *typeAttr;
+			Dwarf::Entry* entry = &dwarf->entries[attr->entryIndex];
+			Elf32_Off offset = dwarf->pointerToOffset(block);
+
+			offset = dwarf->readAttribute(offset, entry, &typeAttrIndex);
+			block = dwarf->offsetToPointer(offset);
+
+			typeAttr = &entry->attributes[typeAttrIndex];
+
+			if (!processTypeAttr(typeAttr, &a->type))
+				return error("Failed to processTypeAttr for subscript data DW_FMT_ET.");
+
+			break;
+		}
+		else if (format == DW_FMT_FT_C_C)
+		{
+			Elf32_Half fundType = dwarf->read<Elf32_Half>(block);
+			block += sizeof(Elf32_Half);
+
+			// Only long indices are supported
+			if (fundType != DW_FT_long)
+				return error(std::string("Subscript data DW_FMT_FT_C_C had unsupported fundamental indice type ").append(toHexString(fundType)).append(" in type '").append(a->toNameString("")).append("'."));
+
+			Elf32_Word lowBound = dwarf->read<Elf32_Word>(block);
+			block += sizeof(Elf32_Word);
+
+			// Only indices starting at 0 are supported
+			if (lowBound != 0)
+				return error(std::string("Subscript data contained indices which did not start at zero! (Start at: '").append(toHexString(lowBound)).append("', Type: '").append(a->toNameString("")).append("')"));
+
+			Elf32_Word highBound = dwarf->read<Elf32_Word>(block);
+			block += sizeof(Elf32_Word);
+
+			Cpp::ArrayType::Dimension dimension;
+			dimension.size = highBound + 1;
+
+			a->dimensions.push_back(dimension);
+		}
+		else
+		{
+			// Only fundamental typed (long) indices and
+			// constant value bounds are supported
+			return error(std::string("Encountered subscript data format unsupported by dwarf2cpp! (").append(toHexString(format)).append(")"));
+		}
+	}
+
+	return true;
+}
+
+void replaceChar(char *str, char ch, char newCh)
+{
+	char *end = str + strlen(str);
+
+	while (str < end)
+	{
+		if (*str == ch)
+			*str = newCh;
+		str++;
+	}
+}
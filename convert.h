@@ -0,0 +1,52 @@
+#pragma once
+
+#include "elf.h"
+#include "dwarf.h"
+#include "cpp.h"
+#include "queue.h"
+#include "registry.h"
+#include "filter.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+class OutputWriter;
+
+// Converts DWARF 1 entries into the Cpp model. The converter handles one ELF
+// file per process, so its state and options are globals; they're described
+// where they're defined in convert.cpp.
+
+extern std::vector<Cpp::File*> cppFiles;
+extern TypeRegistry typeRegistry;
+
+extern OutputWriter *pipelineWriter;
+extern std::set<Cpp::File*> dispatchedFiles;
+extern std::vector<Cpp::File*> modifiedFiles;
+
+extern int shard;
+extern int shardCount;
+extern bool typesOnly;
+extern SymbolFilter filter;
+
+extern std::map<Cpp::UserType*, int> userTypeEntries;
+
+bool error(std::string errorMessage);
+bool isInShard(Cpp::File *cpp);
+
+Dwarf* loadDwarf(ElfFile *elf);
+void readCompileUnits(Dwarf *dwarf, BoundedQueue<int> *units);
+bool processDwarf(Dwarf *dwarf);
+Cpp::File* convertCompileUnit(Dwarf::Entry *entry);
+
+bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type);
+bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u);
+
+// Forgets everything converted so far, so another file can be converted in
+// the same process. The model itself isn't freed.
+void resetConverter();
+
+// Frees the files in cppFiles, their types and the types' data. Call it
+// before resetConverter when nothing refers to the model any more.
+void freeModel();
@@ -1,125 +1,122 @@
 #include "cpp.h"
 
+#include <algorithm>
+
 namespace Cpp
 {
 static inline std::string toHexString(int x)
 {
-	std::stringstream ss;
-	ss << std::hex << std::showbase << x;
-	return ss.str();
+	Emitter out;
+	out.hex(x);
+	return out.buffer;
 }
 
-std::string File::toString(bool justUserTypes, bool includeComments)
+static inline const char *fundamentalTypeName(FundamentalType ft)
 {
-	std::stringstream ss;
-
-	// Write class/enum declarations
-	for (UserType *ut : userTypes)
+	switch (ft)
 	{
-		if (ut->type == UserType::CLASS ||
-			ut->type == UserType::UNION ||
-			ut->type == UserType::STRUCT || 
-			ut->type == UserType::ENUM)
-			ss << ut->toDeclarationString() << "\n";
+	case FundamentalType::CHAR:
+	case FundamentalType::SIGNED_CHAR:
+		return "char";
+	case FundamentalType::UNSIGNED_CHAR:
+		return "unsigned char";
+	case FundamentalType::SHORT:
+	case FundamentalType::SIGNED_SHORT:
+		return "short";
+	case FundamentalType::UNSIGNED_SHORT:
+		return "unsigned short";
+	case FundamentalType::INT:
+	case FundamentalType::SIGNED_INT:
+		return "int";
+	case FundamentalType::UNSIGNED_INT:
+		return "unsigned int";
+	case FundamentalType::LONG:
+	case FundamentalType::SIGNED_LONG:
+		return "long";
+	case FundamentalType::UNSIGNED_LONG:
+		return "unsigned long";
+	case FundamentalType::FLOAT:
+		return "float";
+	case FundamentalType::DOUBLE:
+		return "double";
+	case FundamentalType::LONG_DOUBLE:
+		return "long double";
+	case FundamentalType::VOID:
+		return "void";
+	case FundamentalType::BOOL:
+		return "bool";
+	case FundamentalType::LONG_LONG:
+	case FundamentalType::SIGNED_LONG_LONG:
+		return "long long";
+	case FundamentalType::UNSIGNED_LONG_LONG:
+		return "unsigned long long";
 	}
 
-	ss << "\n";
+	return nullptr;
+}
 
-	// Write function type definitions
-	for (UserType *ut : userTypes)
+static inline const char *modifierName(Type::Modifier m)
+{
+	switch (m)
 	{
-		if (ut->type == UserType::FUNCTION)
-			ss << ut->toDeclarationString() << "\n";
+	case Type::CONST:
+		return "const";
+	case Type::POINTER_TO:
+		return "*";
+	case Type::REFERENCE_TO:
+		return "&";
+	case Type::VOLATILE:
+		return "volatile";
 	}
 
-	ss << "\n";
-
-	// Write array type declarations
-	for (UserType *ut : userTypes)
-	{
-		if (ut->type == UserType::ARRAY)
-			ss << ut->toDeclarationString() << "\n";
-	}
+	return nullptr;
+}
 
-	ss << "\n";
+void File::emit(Emitter &out, bool justUserTypes, bool includeComments)
+{
+	CppVisitor visitor(out, justUserTypes, includeComments);
+	Walk(this, justUserTypes, { &visitor });
+}
 
-	// Write class/enum definitions
-	for (UserType *ut : userTypes)
-	{
-		if (ut->type == UserType::CLASS ||
-			ut->type == UserType::UNION ||
-			ut->type == UserType::STRUCT ||
-			ut->type == UserType::ENUM)
-		{
-			ss << ut->toDefinitionString(includeComments) << "\n\n";
-		}
-	}
+std::string File::toString(bool justUserTypes, bool includeComments)
+{
+	Emitter out;
+	emit(out, justUserTypes, includeComments);
+	return out.buffer;
+}
 
-	if (!justUserTypes)
+void Type::emit(Emitter &out, const std::string &varName)
+{
+	if (!isFundamentalType &&
+		(userType->type == UserType::ARRAY || userType->type == UserType::FUNCTION))
 	{
-		// Write variables
-		for (Variable &var : variables)
-		{
-			if (includeComments)
-			{
-				std::string globallocal = (var.isGlobal) ? "GLOBAL" : "LOCAL ";
-				ss << StarCommentToString(globallocal, false) << " ";
-			}
-			
-			ss << var.toString() << ";\n";
-		}
-
-		ss << "\n";
-
-		// Write function declarations
-		for (Function &fun : functions)
-		{
-			if (includeComments)
-			{
-				std::string globallocal = (fun.isGlobal) ? "GLOBAL" : "LOCAL ";
-				ss << StarCommentToString(globallocal, false) << " ";
-			}
-			ss << fun.toDeclarationString() << "\n";
-		}
-
-		ss << "\n";
-
-		// Write function definitions
-		for (Function &fun : functions)
-			ss << fun.toDefinitionString() << "\n\n";
+		userType->emitDeclarator(out, varName);
+		return;
 	}
 
-	return ss.str();
-}
-
-std::string Type::toString(std::string varName) {
-	std::stringstream result;
-
 	// Add prefix modifiers.
 	for (Modifier mod : modifiers)
 		if (mod == Modifier::CONST || mod == Modifier::VOLATILE)
-			result << ModifierToString(mod) << " ";
+			out << modifierName(mod) << ' ';
 
-	if (isFundamentalType) {
-		result << FundamentalTypeToString(fundamentalType);
-	} else if (userType->type == UserType::ARRAY) {
-		return userType->arrayData->toNameString(varName);
-	}
-	else if (userType->type == UserType::FUNCTION) {
-		return userType->functionData->toNameString(varName);
-	}
-	else {
-		result << userType->name;
-	}
+	if (isFundamentalType)
+		EmitFundamentalType(out, fundamentalType);
+	else
+		out << userType->name;
 
 	for (Modifier mod : modifiers)
 		if (mod == Modifier::POINTER_TO || mod == Modifier::REFERENCE_TO)
-			result << ModifierToString(mod);
+			out << modifierName(mod);
 
 	if (!varName.empty())
-		result << " " << varName;
+		out << ' ' << varName;
+}
 
-	return result.str();
+std::string Type::toString(std::string varName)
+{
+	Emitter out;
+	emit(out, varName);
+	return out.buffer;
 }
 
 std::string Type::toString()
@@ -127,89 +124,150 @@ std::string Type::toString()
 	return toString("");
 }
 
-std::string Variable::toString()
+void Variable::emit(Emitter &out)
 {
-	std::stringstream ss;
-	ss << type.toString(name);
-	return ss.str();
+	type.emit(out, name);
 }
 
-std::string UserType::toDeclarationString()
+void UserType::emitDeclaration(Emitter &out)
 {
-	std::stringstream ss;
-	ss << "typedef " << toNameString(false, false) << ";";
-	return ss.str();
+	out << "typedef ";
+	emitName(out, false, false);
+	out << ';';
 }
 
-std::string UserType::toDefinitionString(bool includeComments)
+void UserType::emitDefinition(Emitter &out, bool includeComments)
 {
-	std::stringstream ss;
-	ss << toNameString(includeComments, true) << "\n";
+	emitName(out, includeComments, true);
+	out << '\n';
 
 	switch (type)
 	{
 	case UNION:
 	case STRUCT:
 	case CLASS:
-		ss << classData->toBodyString(includeComments);
+		classData->emitBody(out, includeComments);
 		break;
 	case ENUM:
-		ss << enumData->toBodyString();
+		enumData->emitBody(out);
 		break;
 	}
 
-	ss << ";";
-
-	return ss.str();
+	out << ';';
 }
 
-std::string UserType::toNameString(bool includeSize, bool includeInheritances)
+void UserType::emitName(Emitter &out, bool includeSize, bool includeInheritances)
 {
 	switch (type)
 	{
 	case UNION:
 	case STRUCT:
 	case CLASS:
-		return classData->toNameString(name, includeSize, includeInheritances);
+		classData->emitName(out, name, includeSize, includeInheritances);
+		return;
 	case ENUM:
-		return enumData->toNameString(name);
+		enumData->emitName(out, name);
+		return;
 	case ARRAY:
-		return arrayData->toNameString(name);
 	case FUNCTION:
-		return functionData->toNameString(name);
+		emitDeclarator(out, name);
+		return;
 	}
 
-	return "<unknown user type (" + toHexString(type) + ")>";
+	out << "<unknown user type (";
+	out.hex(type) << ")>";
+}
+
+void UserType::emitDeclarator(Emitter &out, const std::string &varName)
+{
+	if (!nameCached)
+		cacheNameFragments();
+
+	out << namePrefix;
+	if (nameSpaced && !varName.empty())
+		out << ' ';
+	out << varName << nameSuffix;
+}
+
+void UserType::cacheNameFragments()
+{
+	// Mark the cache valid up front so self-referencing types terminate
+	nameCached = true;
+
+	Emitter out;
+
+	if (type == ARRAY)
+	{
+		Type &element = arrayData->type;
+
+		if (!element.isFundamentalType &&
+			(element.userType->type == ARRAY || element.userType->type == FUNCTION))
+		{
+			UserType *inner = element.userType;
+
+			if (!inner->nameCached)
+				inner->cacheNameFragments();
+
+			namePrefix = inner->namePrefix;
+			nameSpaced = inner->nameSpaced;
+			out << inner->nameSuffix;
+		}
+		else
+		{
+			element.emit(out, "");
+			namePrefix = out.buffer;
+			nameSpaced = true;
+			out.clear();
+		}
+
+		for (ArrayType::Dimension &d : arrayData->dimensions)
+			out << '[' << d.size << ']';
+
+		nameSuffix = out.buffer;
+	}
+	else if (type == FUNCTION)
+	{
+		functionData->returnType.emit(out, "");
+		out << "(*";
+		namePrefix = out.buffer;
+		nameSpaced = false;
+
+		out.clear();
+		out << ')';
+		functionData->emitParameters(out);
+		nameSuffix = out.buffer;
+	}
+	else
+	{
+		namePrefix = name;
+		nameSpaced = true;
+		nameSuffix.clear();
+	}
 }
 
-std::string ClassType::toNameString(std::string name, bool includeSize, bool includeInheritances)
+void ClassType::emitName(Emitter &out, const std::string &name, bool includeSize, bool includeInheritances)
 {
-	std::stringstream ss;
-	ss << std::string((parent->type == UserType::STRUCT) ? "struct " : ((parent->type == UserType::UNION) ? "union " : "class ")) << name;
+	out << ((parent->type == UserType::STRUCT) ? "struct " : ((parent->type == UserType::UNION) ? "union " : "class ")) << name;
 
 	if (includeInheritances)
 	{
 		for (size_t i = 0; i < inheritances.size(); i++)
 		{
-			std::string type = inheritances[i].type.toString();
-
-			if (i == 0)
-				ss << " : " << type;
-			else
-				ss << ", " << type;
+			out << ((i == 0) ? " : " : ", ");
+			inheritances[i].type.emit(out, "");
 		}
 	}
 	
 	if (includeSize)
-		ss << " " + StarCommentToString(toHexString(size), false);
-
-	return ss.str();
+	{
+		out << " /* ";
+		out.hex(size) << " */";
+	}
 }
 
-std::string ClassType::toBodyString(bool includeOffsets)
+void ClassType::emitBody(Emitter &out, bool includeOffsets)
 {
-	std::stringstream ss;
-	ss << "{\n";
+	out << "{\n";
 
 	bool includeUnions = (parent->type != UserType::UNION);
 	int unionOffset = -1;
@@ -218,7 +276,7 @@ std::string ClassType::toBodyString(bool includeOffsets)
 
 	for (size_t i = 0; i < size; i++)
 	{
-		ss << "\t";
+		out << '\t';
 
 		Member &m = members[i];
 		int offset = m.offset;
@@ -229,177 +287,173 @@ std::string ClassType::toBodyString(bool includeOffsets)
 			unionOffset = offset;
 
 			if (m.bit_size == -1) {
-				ss << "union";
+				out << "union";
 			}
 			else {
-				ss << "struct";
+				out << "struct";
 			}
 
-			ss << "\n\t{\n\t";
+			out << "\n\t{\n\t";
 		}
 
 		if (includeUnions && unionOffset != -1)
-			ss << "\t";
+			out << '\t';
 
-		ss << m.toString(includeOffsets) << ";\n";
+		m.emit(out, includeOffsets);
+		out << ";\n";
 
 		if (includeUnions && unionOffset != -1 &&
 			(i == size - 1 || members[i+1].offset != offset))
 		{
 			unionOffset = -1;
-			ss << "\t};\n";
+			out << "\t};\n";
 		}
 	}
 
 	if (functions.size() > 0) {
-		ss << "\n";
+		out << '\n';
 		for (Function& fun : functions) {
-			ss << "\t" << fun.toDeclarationString() << "\n";
+			out << '\t';
+			fun.emitDeclaration(out);
+			out << '\n';
 		}
 	}
 
-	ss << "}";
-
-	return ss.str();
+	out << '}';
 }
 
-std::string ClassType::Member::toString(bool includeOffset)
+void ClassType::Member::emit(Emitter &out, bool includeOffset)
 {
-	std::stringstream ss;
-
 	if (includeOffset)
-		ss << StarCommentToString(toHexString(offset), false) << " ";
+	{
+		out << "/* ";
+		out.hex(offset) << " */ ";
+	}
 
-	ss << type.toString(name);
+	type.emit(out, name);
 	if (bit_size != -1)
-		ss << " : " << bit_size;
-
-	return ss.str();
+		out << " : " << bit_size;
 }
 
-std::string EnumType::toNameString(std::string name)
+void EnumType::emitName(Emitter &out, const std::string &name)
 {
-	std::stringstream ss;
-	ss << "enum " << name;
+	out << "enum " << name;
 	if (baseType != Cpp::FundamentalType::INT)
-		ss << " : " << FundamentalTypeToString(baseType);
-	return ss.str();
+	{
+		out << " : ";
+		EmitFundamentalType(out, baseType);
+	}
 }
 
-std::string EnumType::toBodyString()
+void EnumType::emitBody(Emitter &out)
 {
-	std::stringstream ss;
-
-	ss << "{\n";
+	out << "{\n";
 
 	int lastValue = -1;
 	size_t size = elements.size();
 
 	for (size_t i = 0; i < size; i++)
 	{
-		ss << "\t" << elements[i].toString(lastValue);
+		out << '\t';
+		elements[i].emit(out, lastValue);
 
 		lastValue = elements[i].constValue;
 
 		if (i != size - 1)
-			ss << ",";
+			out << ',';
 
-		ss << "\n";
+		out << '\n';
 	}
 
-	ss << "}";
-
-	return ss.str();
+	out << '}';
 }
 
-std::string EnumType::Element::toString(int lastValue)
+void EnumType::Element::emit(Emitter &out, int lastValue)
 {
-	std::stringstream ss;
-	ss << name;
+	out << name;
 
 	if (constValue != lastValue + 1)
-		ss << " = " << toHexString(constValue);
-
-	return ss.str();
+	{
+		out << " = ";
+		out.hex(constValue);
+	}
 }
 
-std::string ArrayType::toNameString(std::string name)
+void ArrayType::emitName(Emitter &out, const std::string &name)
 {
-	std::stringstream ss;
-	ss << type.toString(name);
+	type.emit(out, name);
 
 	for (Dimension &d : dimensions)
-		ss << "[" << std::to_string(d.size) << "]";
-
-	return ss.str();
+		out << '[' << d.size << ']';
 }
 
-std::string FunctionType::toNameString(std::string name)
+std::string ArrayType::toNameString(std::string name)
 {
-	std::stringstream ss;
+	Emitter out;
+	emitName(out, name);
+	return out.buffer;
+}
 
+void FunctionType::emitName(Emitter &out, const std::string &name)
+{
 	// This isn't really a function pointer, but we'll print it as if it is
 	// DWARF is weird
-	ss << returnType.toString() << "(*" << name << ")" << toParametersString();
-	return ss.str();
+	returnType.emit(out, "");
+	out << "(*" << name << ')';
+	emitParameters(out);
 }
 
-std::string FunctionType::toParametersString()
+void FunctionType::emitParameters(Emitter &out)
 {
-	std::stringstream ss;
-	ss << "(";
+	out << '(';
 
 	size_t size = parameters.size();
 
 	for (size_t i = 0; i < size; i++)
 	{
-		ss << parameters[i].toString();
+		parameters[i].emit(out);
 
 		if (i != size - 1)
-			ss << ", ";
+			out << ", ";
 	}
 
-	ss << ")";
-
-	return ss.str();
+	out << ')';
 }
 
-std::string FunctionType::Parameter::toString()
+void FunctionType::Parameter::emit(Emitter &out)
 {
-	return type.toString(name);
+	type.emit(out, name);
 }
 
-std::string Function::toNameString(bool skipNamespace)
+void Function::emitName(Emitter &out, bool skipNamespace)
 {
-	std::stringstream ss;
-	ss << returnType.toString() << " ";
+	returnType.emit(out, "");
+	out << ' ';
 	if (typeOwner != nullptr && !skipNamespace)
-		ss << typeOwner->name << "::";
-	ss << name << toParametersString();
-	return ss.str();
-}
-
-std::string Function::toNameString()
-{
-	return toNameString(false);
+		out << typeOwner->name << "::";
+	out << name;
+	emitParameters(out);
 }
 
-std::string Function::toDeclarationString()
+void Function::emitDeclaration(Emitter &out)
 {
-	std::stringstream ss;
-	ss << toNameString(true) << ";";
-	return ss.str();
+	emitName(out, true);
+	out << ';';
 }
 
-std::string Function::toDefinitionString()
+void Function::emitDefinition(Emitter &out)
 {
-	std::stringstream ss;
-	ss << CommentToString(mangledName) <<
-		CommentToString("Start address: " + toHexString(startAddress)) <<
-		toNameString() << "\n{\n";
+	out << "// " << mangledName << "\n// Start address: ";
+	out.hex(startAddress) << '\n';
+	emitName(out, false);
+	out << "\n{\n";
 
 	for (Variable &v : variables)
-		ss << "\t" << v.toString() << ";\n";
+	{
+		out << '\t';
+		v.emit(out);
+		out << ";\n";
+	}
 
 	// Save line numbers.
 	if (dwarf != nullptr) {
@@ -408,70 +462,47 @@ std::string Function::toDefinitionString()
 			std::pair<std::multimap<int, Dwarf::LineEntry>::iterator, std::multimap<int, Dwarf::LineEntry>::iterator> ret;
 			ret = dwarf->lineEntryMap.equal_range(startAddress);
 			for (std::multimap<int, Dwarf::LineEntry>::iterator it = ret.first; it != ret.second; ++it) {
-				ss << "\t// ";
+				out << "\t// ";
 				if (it->second.lineNumber != 0) {
-					ss << "Line " << it->second.lineNumber;
+					out << "Line " << it->second.lineNumber;
 				}
 				else {
-					ss << "Func End";
+					out << "Func End";
 				}
 				
 				if (it->second.charOffset != (short)-1)
-					ss << ", Character " << it->second.charOffset;
-				ss << ", Address: " << toHexString(startAddress + it->second.hexAddressOffset) << ", Func Offset: " << toHexString(it->second.hexAddressOffset) << "\n";
+					out << ", Character " << it->second.charOffset;
+				out << ", Address: ";
+				out.hex(startAddress + it->second.hexAddressOffset) << ", Func Offset: ";
+				out.hex(it->second.hexAddressOffset) << '\n';
 			}
 		}
 	}
 
-	ss << "}";
-
-	return ss.str();
+	out << '}';
 }
 
 std::string FundamentalTypeToString(FundamentalType ft)
 {
-	switch (ft)
+	const char *name = fundamentalTypeName(ft);
+
+	if (name)
+		return name;
+
+	return "<unknown fundamental type (" + toHexString(ft) + ")>";
+}
+
+void EmitFundamentalType(Emitter &out, FundamentalType ft)
+{
+	const char *name = fundamentalTypeName(ft);
+
+	if (name)
+		out << name;
+	else
 	{
-	case FundamentalType::CHAR:
-	case FundamentalType::SIGNED_CHAR:
-		return "char";
-	case FundamentalType::UNSIGNED_CHAR:
-		return "unsigned char";
-	case FundamentalType::SHORT:
-	case FundamentalType::SIGNED_SHORT:
-		return "short";
-	case FundamentalType::UNSIGNED_SHORT:
-		return "unsigned short";
-	case FundamentalType::INT:
-	case FundamentalType::SIGNED_INT:
-		return "int";
-	case FundamentalType::UNSIGNED_INT:
-		return "unsigned int";
-	case FundamentalType::LONG:
-	case FundamentalType::SIGNED_LONG:
-		return "long";
-	case FundamentalType::UNSIGNED_LONG:
-		return "unsigned long";
-	case FundamentalType::FLOAT:
-		return "float";
-	case FundamentalType::DOUBLE:
-		return "double";
-	case FundamentalType::LONG_DOUBLE:
-		return "long double";
-	case FundamentalType::VOID:
-		return "void";
-	case FundamentalType::BOOL:
-		return "bool";
-	case FundamentalType::LONG_LONG:
-	case FundamentalType::SIGNED_LONG_LONG:
-		return "long long";
-	case FundamentalType::UNSIGNED_LONG_LONG:
-		return "unsigned long long";
+		out << "<unknown fundamental type (";
+		out.hex(ft) << ")>";
 	}
-
-	std::stringstream ss;
-	ss << "<unknown fundamental type (" << toHexString(ft) << ")>";
-	return ss.str();
 }
 
 int GetFundamentalTypeSize(FundamentalType ft)
@@ -513,57 +544,121 @@ int GetFundamentalTypeSize(FundamentalType ft)
 	return -1;
 }
 
-int Type::size() {
-	if (modifiers.size() > 0)
-		for (Cpp::Type::Modifier modifier : modifiers)
-			if (modifier == Cpp::Type::Modifier::POINTER_TO || modifier == Cpp::Type::Modifier::REFERENCE_TO)
-				return 4;
+bool Type::isIndirect()
+{
+	for (Modifier mod : modifiers)
+		if (mod == Modifier::POINTER_TO || mod == Modifier::REFERENCE_TO)
+			return true;
+
+	return false;
+}
+
+int Type::size()
+{
+	if (isIndirect())
+		return 4;
+
+	if (isFundamentalType)
+		return GetFundamentalTypeSize(fundamentalType);
+
+	if (userType->layoutState != UserType::LAYOUT_DONE)
+		userType->computeLayout();
+
+	return userType->byteSize;
+}
+
+int Type::alignment()
+{
+	if (isIndirect())
+		return 4;
 
-	if (isFundamentalType) {
+	if (isFundamentalType)
 		return GetFundamentalTypeSize(fundamentalType);
+
+	if (userType->layoutState != UserType::LAYOUT_DONE)
+		userType->computeLayout();
+
+	return userType->byteAlignment;
+}
+
+void UserType::computeLayout()
+{
+	// A type that is still pending is being laid out further up the stack,
+	// which can only happen with malformed data (pointers never recurse).
+	// Leave it unknown instead of looping.
+	if (layoutState != LAYOUT_NONE)
+		return;
+
+	layoutState = LAYOUT_PENDING;
+
+	switch (type)
+	{
+	case UNION:
+	case STRUCT:
+	case CLASS:
+	{
+		byteSize = classData->size;
+		byteAlignment = 1;
+
+		for (ClassType::Inheritance &i : classData->inheritances)
+			byteAlignment = std::max(byteAlignment, i.type.alignment());
+
+		for (ClassType::Member &m : classData->members)
+			byteAlignment = std::max(byteAlignment, m.type.alignment());
+
+		break;
 	}
-	else {
-		switch (userType->type) {
-		case Cpp::UserType::STRUCT:
-		case Cpp::UserType::CLASS:
-		case Cpp::UserType::UNION:
-			return userType->classData->size;
-			break;
-		case Cpp::UserType::ARRAY:
-			int amount;
-			amount = 1;
-			if (userType->arrayData->dimensions.size() > 0)
-				for (auto dimension : userType->arrayData->dimensions)
-					amount *= dimension.size;
-			return amount * userType->arrayData->type.size();
-			break;
-		case Cpp::UserType::FUNCTION:
-			return 4;
-			break;
-		case Cpp::UserType::ENUM:
-			return GetFundamentalTypeSize(userType->enumData->baseType);
-			break;
+	case ENUM:
+		byteSize = GetFundamentalTypeSize(enumData->baseType);
+		byteAlignment = byteSize;
+		break;
+	case ARRAY:
+	{
+		int elementSize = arrayData->type.size();
+
+		if (elementSize >= 0)
+		{
+			byteSize = elementSize;
+
+			for (ArrayType::Dimension &d : arrayData->dimensions)
+				byteSize *= d.size;
 		}
+
+		byteAlignment = arrayData->type.alignment();
+		break;
 	}
+	case FUNCTION:
+		byteSize = 4;
+		byteAlignment = 4;
+		break;
+	}
+
+	layoutState = LAYOUT_DONE;
+}
+
+void ComputeLayouts(File *file)
+{
+	for (UserType *ut : file->userTypes)
+		ut->computeLayout();
+}
+
+// Fills the file's declarator caches up front, after which rendering it no
+// longer writes to the model and it can be rendered on another thread.
+void CacheNameFragments(File *file)
+{
+	for (UserType *ut : file->userTypes)
+		if ((ut->type == UserType::ARRAY || ut->type == UserType::FUNCTION) && !ut->nameCached)
+			ut->cacheNameFragments();
 }
 
 std::string Type::ModifierToString(Modifier m)
 {
-	switch (m)
-	{
-	case CONST:
-		return "const";
-	case POINTER_TO:
-		return "*";
-	case REFERENCE_TO:
-		return "&";
-	case VOLATILE:
-		return "volatile";
-	}
+	const char *name = modifierName(m);
 
-	std::stringstream ss;
-	ss << "<unknown modifier (" << toHexString(m) << ")>";
-	return ss.str();
+	if (name)
+		return name;
+
+	return "<unknown modifier (" + toHexString(m) + ")>";
 }
 
 std::string CommentToString(std::string comment)
@@ -578,4 +673,123 @@ std::string StarCommentToString(std::string comment, bool multiline)
 	else
 		return "/* " + comment + " */";
 }
+
+CppVisitor::CppVisitor(Emitter &out, bool justUserTypes, bool includeComments) : m_out(out)
+{
+	m_justUserTypes = justUserTypes;
+	m_includeComments = includeComments;
+}
+
+void CppVisitor::beginFile(File * /*file*/)
+{
+	m_typeDeclarations.clear();
+	m_functionTypes.clear();
+	m_arrayTypes.clear();
+	m_definitions.clear();
+	m_variables.clear();
+	m_functionDeclarations.clear();
+	m_functionDefinitions.clear();
+}
+
+void CppVisitor::visitUserType(UserType *ut)
+{
+	switch (ut->type)
+	{
+	case UserType::FUNCTION:
+		// Function type definitions
+		ut->emitDeclaration(m_functionTypes);
+		m_functionTypes << '\n';
+		break;
+	case UserType::ARRAY:
+		// Array type declarations
+		ut->emitDeclaration(m_arrayTypes);
+		m_arrayTypes << '\n';
+		break;
+	default:
+		// Class/enum declarations and definitions
+		ut->emitDeclaration(m_typeDeclarations);
+		m_typeDeclarations << '\n';
+
+		ut->emitDefinition(m_definitions, m_includeComments);
+		m_definitions << "\n\n";
+		break;
+	}
+}
+
+void CppVisitor::visitVariable(Variable &v)
+{
+	if (m_includeComments)
+		m_variables << ((v.isGlobal) ? "/* GLOBAL */ " : "/* LOCAL  */ ");
+
+	v.emit(m_variables);
+	m_variables << ";\n";
+}
+
+void CppVisitor::visitFunction(Function &f)
+{
+	if (m_includeComments)
+		m_functionDeclarations << ((f.isGlobal) ? "/* GLOBAL */ " : "/* LOCAL  */ ");
+
+	f.emitDeclaration(m_functionDeclarations);
+	m_functionDeclarations << '\n';
+
+	f.emitDefinition(m_functionDefinitions);
+	m_functionDefinitions << "\n\n";
+}
+
+void CppVisitor::endFile(File * /*file*/)
+{
+	std::string &buffer = m_out.buffer;
+
+	buffer.reserve(buffer.size() + m_typeDeclarations.buffer.size() + m_functionTypes.buffer.size() + m_arrayTypes.buffer.size() +
+		m_definitions.buffer.size() + m_variables.buffer.size() + m_functionDeclarations.buffer.size() + m_functionDefinitions.buffer.size() + 5);
+
+	buffer += m_typeDeclarations.buffer;
+	buffer += '\n';
+	buffer += m_functionTypes.buffer;
+	buffer += '\n';
+	buffer += m_arrayTypes.buffer;
+	buffer += '\n';
+	buffer += m_definitions.buffer;
+
+	if (!m_justUserTypes)
+	{
+		buffer += m_variables.buffer;
+		buffer += '\n';
+		buffer += m_functionDeclarations.buffer;
+		buffer += '\n';
+		buffer += m_functionDefinitions.buffer;
+	}
+}
+
+void Walk(File *file, bool justUserTypes, const std::vector<ModelVisitor*> &visitors)
+{
+	for (ModelVisitor *visitor : visitors)
+		visitor->beginFile(file);
+
+	for (UserType *ut : file->userTypes)
+	{
+		for (ModelVisitor *visitor : visitors)
+			visitor->visitUserType(ut);
+	}
+
+	if (!justUserTypes)
+	{
+		for (Variable &v : file->variables)
+		{
+			for (ModelVisitor *visitor : visitors)
+				visitor->visitVariable(v);
+		}
+
+		for (Function &f : file->functions)
+		{
+			for (ModelVisitor *visitor : visitors)
+				visitor->visitFunction(f);
+		}
+	}
+
+	for (ModelVisitor *visitor : visitors)
+		visitor->endFile(file);
+}
+
 }
\ No newline at end of file
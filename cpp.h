@@ -17,6 +17,7 @@ struct EnumType;
 struct ArrayType;
 struct FunctionType;
 struct Function;
+struct Emitter;
 
 enum FundamentalType
 {
@@ -49,6 +50,7 @@ struct File
 	std::vector<UserType*> userTypes;
 	std::vector<Function> functions;
 
+	void emit(Emitter &out, bool justUserTypes, bool includeComments);
 	std::string toString(bool justUserTypes, bool includeComments);
 };
 
@@ -72,6 +74,9 @@ struct Type
 	};
 
 	int size();
+	int alignment();
+	bool isIndirect();
+	void emit(Emitter &out, const std::string &varName);
 	std::string toString(std::string varName);
 	std::string toString();
 	static std::string ModifierToString(Modifier m);
@@ -83,7 +88,7 @@ struct Variable
 	bool isGlobal;
 	Type type;
 
-	std::string toString();
+	void emit(Emitter &out);
 };
 
 struct UserType
@@ -100,9 +105,31 @@ struct UserType
 		FunctionType *functionData;
 	};
 
-	std::string toDeclarationString();
-	std::string toDefinitionString(bool includeComments);
-	std::string toNameString(bool includeSize, bool includeInheritances);
+	// File this type was read into
+	File *file = nullptr;
+
+	// Cached declarator pieces for ARRAY and FUNCTION types, so that a
+	// variable X of this type renders as prefix + X + suffix. They are
+	// built lazily and cleared when the names in the type's compile unit
+	// are fixed up.
+	std::string namePrefix;
+	std::string nameSuffix;
+	bool nameSpaced;
+	bool nameCached = false;
+
+	// Size and alignment in bytes, or -1 if unknown. Filled in once by
+	// computeLayout(), which resolves the types this one depends on first.
+	enum { LAYOUT_NONE, LAYOUT_PENDING, LAYOUT_DONE } layoutState = LAYOUT_NONE;
+	int byteSize = -1;
+	int byteAlignment = -1;
+
+	void computeLayout();
+
+	void emitDeclaration(Emitter &out);
+	void emitDefinition(Emitter &out, bool includeComments);
+	void emitName(Emitter &out, bool includeSize, bool includeInheritances);
+	void emitDeclarator(Emitter &out, const std::string &varName);
+	void cacheNameFragments();
 };
 
 struct ClassType
@@ -115,7 +142,7 @@ struct ClassType
 		int bit_offset;
 		int bit_size;
 
-		std::string toString(bool includeOffset);
+		void emit(Emitter &out, bool includeOffset);
 	};
 
 	struct Inheritance
@@ -130,8 +157,8 @@ struct ClassType
 	std::vector<Inheritance> inheritances;
 	std::vector<Function> functions;
 
-	std::string toNameString(std::string name, bool includeSize, bool includeInheritances);
-	std::string toBodyString(bool includeOffsets);
+	void emitName(Emitter &out, const std::string &name, bool includeSize, bool includeInheritances);
+	void emitBody(Emitter &out, bool includeOffsets);
 	bool isUnion();
 };
 
@@ -142,14 +169,14 @@ struct EnumType
 		std::string name;
 		long constValue;
 
-		std::string toString(int lastValue);
+		void emit(Emitter &out, int lastValue);
 	};
 
 	FundamentalType baseType;
 	std::vector<Element> elements;
 
-	std::string toNameString(std::string name);
-	std::string toBodyString();
+	void emitName(Emitter &out, const std::string &name);
+	void emitBody(Emitter &out);
 };
 
 struct ArrayType
@@ -162,6 +189,7 @@ struct ArrayType
 	Type type;
 	std::vector<Dimension> dimensions;
 
+	void emitName(Emitter &out, const std::string &name);
 	std::string toNameString(std::string name);
 };
 
@@ -172,14 +200,14 @@ struct FunctionType
 		std::string name;
 		Type type;
 
-		std::string toString();
+		void emit(Emitter &out);
 	};
 
 	Type returnType;
 	std::vector<Parameter> parameters;
 
-	std::string toNameString(std::string name);
-	std::string toParametersString();
+	void emitName(Emitter &out, const std::string &name);
+	void emitParameters(Emitter &out);
 };
 
 struct Function : FunctionType
@@ -193,14 +221,140 @@ struct Function : FunctionType
 	UserType* typeOwner;
 	Dwarf* dwarf;
 
-	std::string toNameString();
-	std::string toNameString(bool skipNamespace);
-	std::string toDeclarationString();
-	std::string toDefinitionString();
+	void emitName(Emitter &out, bool skipNamespace);
+	void emitDeclaration(Emitter &out);
+	void emitDefinition(Emitter &out);
 };
 
+// Growable output buffer that the emit functions append to directly.
+// One buffer is filled per output file, so rendering doesn't go through
+// intermediate streams or temporary strings.
+struct Emitter
+{
+	std::string buffer;
+
+	inline Emitter &operator<<(const std::string &s)
+	{
+		buffer.append(s);
+		return *this;
+	}
+
+	inline Emitter &operator<<(const char *s)
+	{
+		buffer.append(s);
+		return *this;
+	}
+
+	inline Emitter &operator<<(char c)
+	{
+		buffer.push_back(c);
+		return *this;
+	}
+
+	inline Emitter &operator<<(int x)
+	{
+		char digits[16];
+		char *end = digits + sizeof(digits);
+		char *p = end;
+		unsigned int u = (x < 0) ? 0u - (unsigned int)x : (unsigned int)x;
+
+		do
+		{
+			*--p = '0' + (u % 10);
+			u /= 10;
+		} while (u);
+
+		if (x < 0)
+			*--p = '-';
+
+		buffer.append(p, end - p);
+		return *this;
+	}
+
+	// Same format as std::hex << std::showbase (no prefix for zero)
+	inline Emitter &hex(int x)
+	{
+		static const char hexDigits[] = "0123456789abcdef";
+
+		char digits[16];
+		char *end = digits + sizeof(digits);
+		char *p = end;
+		unsigned int u = (unsigned int)x;
+
+		do
+		{
+			*--p = hexDigits[u & 0xf];
+			u >>= 4;
+		} while (u);
+
+		if (x != 0)
+		{
+			*--p = 'x';
+			*--p = '0';
+		}
+
+		buffer.append(p, end - p);
+		return *this;
+	}
+
+	inline void clear()
+	{
+		buffer.clear();
+	}
+};
+
+// Receives the parts of a file's model in the order Walk() visits them:
+// user types, then variables, then functions. Several visitors can share
+// one walk, so rendering a file in more than one format reads the model
+// only once.
+class ModelVisitor
+{
+public:
+	virtual ~ModelVisitor() {}
+
+	virtual void beginFile(File * /*file*/) {}
+	virtual void visitUserType(UserType * /*ut*/) {}
+	virtual void visitVariable(Variable & /*v*/) {}
+	virtual void visitFunction(Function & /*f*/) {}
+	virtual void endFile(File * /*file*/) {}
+};
+
+// Renders a file as C++ source. The output groups user types by kind and
+// puts function declarations ahead of the definitions, so each section is
+// rendered on the side and they're appended in order when the file ends.
+class CppVisitor : public ModelVisitor
+{
+public:
+	CppVisitor(Emitter &out, bool justUserTypes, bool includeComments);
+
+	void beginFile(File *file) override;
+	void visitUserType(UserType *ut) override;
+	void visitVariable(Variable &v) override;
+	void visitFunction(Function &f) override;
+	void endFile(File *file) override;
+
+private:
+	Emitter &m_out;
+	bool m_justUserTypes;
+	bool m_includeComments;
+
+	Emitter m_typeDeclarations;
+	Emitter m_functionTypes;
+	Emitter m_arrayTypes;
+	Emitter m_definitions;
+	Emitter m_variables;
+	Emitter m_functionDeclarations;
+	Emitter m_functionDefinitions;
+};
+
+// Variables and functions are skipped with justUserTypes
+void Walk(File *file, bool justUserTypes, const std::vector<ModelVisitor*> &visitors);
+
 std::string FundamentalTypeToString(FundamentalType ft);
+void EmitFundamentalType(Emitter &out, FundamentalType ft);
 int GetFundamentalTypeSize(FundamentalType ft);
+void ComputeLayouts(File *file);
+void CacheNameFragments(File *file);
 std::string CommentToString(std::string comment);
 std::string StarCommentToString(std::string comment, bool multiline);
 std::string IndentToString(int level);
@@ -6,6 +6,7 @@
 #include <vector>
 #include <iostream>
 #include <unordered_map>
+#include <atomic>
 
 #define DW_TAG_padding                0x0000
 #define DW_TAG_array_type             0x0001
@@ -262,6 +263,10 @@ public:
 		Elf32_Half tag;
 		std::vector<Attribute> attributes;
 
+		// False for entries added by skipEntries until decodeEntries is
+		// called on them
+		bool decoded;
+
 		inline bool isNullEntry()
 		{
 			return length < 8;
@@ -269,7 +274,7 @@ public:
 
 		inline Entry* getSibling()
 		{
-			if (index == dwarf->entries.size() - 1)
+			if (index == dwarf->getEntryCount() - 1)
 				return nullptr;
 
 			size_t numAttributes = attributes.size();
@@ -304,10 +309,15 @@ public:
 	std::multimap<int, LineEntry> lineEntryMap;
 	std::vector<Entry> entries;
 
-	Dwarf(ElfFile *elf)
+	// With readAll set to false only the entry index is built, and the
+	// caller reads the entries (readEntry/readEntries) and line data
+	// (readLines) itself, e.g. one compile unit at a time.
+	Dwarf(ElfFile *elf, bool readAll = true)
 	{
 		m_error = ERR_NONE;
 		m_elf = elf;
+		m_entryCount = 0;
+		m_readCount = 0;
 
 		m_section = m_elf->getSectionHeader(".debug");
 
@@ -318,13 +328,55 @@ public:
 		}
 
 		m_sectionData = m_elf->getSectionData(m_section);
-		m_sectionSize = m_section->sh_size;
+		m_sectionSize = m_elf->getSectionSize(m_section);
+
+		indexEntries();
 
+		if (!readAll || m_error)
+			return;
+
+		readEntries(0, m_sectionSize);
+		readLines();
+	}
+
+	// Walks the entry lengths to give every entry its index up front. This
+	// lets references be resolved before the entries they point to are
+	// read, and the entry vector is reserved so it never reallocates, which
+	// keeps Entry pointers valid while other threads read earlier entries.
+	void indexEntries()
+	{
 		Elf32_Off offset = 0;
+		int index = 0;
+
+		while (offset < m_sectionSize)
+		{
+			Elf32_Word length = read<Elf32_Word>(m_sectionData + offset);
 
-		while (offset < m_sectionSize && !m_error)
+			if (length == 0)
+			{
+				m_error = ERR_INVALID_ENTRY;
+				return;
+			}
+
+			m_entryIndexRefMap[offset] = index++;
+			offset += length;
+		}
+
+		m_entryCount = index;
+		entries.reserve(m_entryCount);
+	}
+
+	// Reads entries from offset until end is reached
+	Elf32_Off readEntries(Elf32_Off offset, Elf32_Off end)
+	{
+		while (offset < end && !m_error)
 			offset = readEntry(offset);
 
+		return offset;
+	}
+
+	void readLines()
+	{
 		// Read debug line data.
 		Elf32_Shdr* m_lineHeader;
 		m_lineHeader = m_elf->getSectionHeader(".line");
@@ -335,7 +387,9 @@ public:
 			m_lineSectionDataStart = m_elf->getSectionData(m_lineHeader);
 			m_lineSectionData = m_lineSectionDataStart;
 
-			while (m_lineHeader->sh_size > (int)(m_lineSectionData - m_lineSectionDataStart)) {
+			Elf32_Word lineSectionSize = m_elf->getSectionSize(m_lineHeader);
+
+			while (lineSectionSize > (int)(m_lineSectionData - m_lineSectionDataStart)) {
 				int byteSize;
 				int funcPtr;
 				char* m_lineSectionDataChunkEnd;
@@ -374,33 +428,84 @@ public:
 		entry.offset = offset;
 		entry.length = read<Elf32_Word>(m_sectionData + offset);
 
-		m_entryIndexRefMap[offset] = entry.index;
+		offset = decodeEntry(&entry);
+
+		if (m_error)
+			return 0;
+
+		entries.push_back(entry);
+		m_readCount.store(entries.size(), std::memory_order_release);
+
+		if (outIndex)
+			*outIndex = entry.index;
 
-		Elf32_Word end = offset + entry.length;
+		return offset;
+	}
 
-		if (entry.isNullEntry()) // Null entry
-			offset = end;
-		else
+	// Adds entries from offset until end is reached without reading their
+	// tags or attributes, so they take up their index but cost next to
+	// nothing. decodeEntries fills them in later if they turn out to be
+	// needed.
+	Elf32_Off skipEntries(Elf32_Off offset, Elf32_Off end)
+	{
+		while (offset < end)
 		{
-			offset += sizeof(Elf32_Word);
+			Entry entry;
 
-			entry.tag = read<Elf32_Half>(m_sectionData + offset);
-			offset += sizeof(Elf32_Half);
+			entry.dwarf = this;
+			entry.index = entries.size();
+			entry.offset = offset;
+			entry.length = read<Elf32_Word>(m_sectionData + offset);
+			entry.tag = DW_TAG_padding;
+			entry.decoded = false;
+
+			entries.push_back(entry);
+			offset += entry.length;
+		}
 
-			while (offset < end && !m_error)
-				offset = readAttribute(offset, &entry);
+		m_readCount.store(entries.size(), std::memory_order_release);
 
-			if (offset > end)
-			{
-				m_error = ERR_INVALID_ENTRY;
-				return 0;
-			}
+		return offset;
+	}
+
+	// Decodes the skipped entries in [begin, end)
+	bool decodeEntries(int begin, int end)
+	{
+		for (int i = begin; i < end && !m_error; i++)
+		{
+			if (!entries[i].decoded)
+				decodeEntry(&entries[i]);
 		}
 
-		entries.push_back(entry);
+		return !m_error;
+	}
 
-		if (outIndex)
-			*outIndex = entry.index;
+	Elf32_Off decodeEntry(Entry *entry)
+	{
+		Elf32_Off offset = entry->offset;
+		Elf32_Word end = offset + entry->length;
+
+		entry->decoded = true;
+
+		if (entry->isNullEntry()) // Null entry
+		{
+			entry->tag = DW_TAG_padding;
+			return end;
+		}
+
+		offset += sizeof(Elf32_Word);
+
+		entry->tag = read<Elf32_Half>(m_sectionData + offset);
+		offset += sizeof(Elf32_Half);
+
+		while (offset < end && !m_error)
+			offset = readAttribute(offset, entry);
+
+		if (offset > end)
+		{
+			m_error = ERR_INVALID_ENTRY;
+			return 0;
+		}
 
 		return offset;
 	}
@@ -467,12 +572,31 @@ public:
 		return m_error;
 	}
 
+	// Returns nullptr if there's no entry at ref or it hasn't been read yet
 	inline Entry* getEntryFromReference(Elf32_Off ref)
 	{
-		if (m_entryIndexRefMap.count(ref) == 0)
+		auto it = m_entryIndexRefMap.find(ref);
+
+		if (it == m_entryIndexRefMap.end() || it->second >= m_readCount.load(std::memory_order_acquire))
 			return nullptr;
 
-		return &entries[m_entryIndexRefMap[ref]];
+		return &entries[it->second];
+	}
+
+	inline bool hasEntryAt(Elf32_Off offset)
+	{
+		return m_entryIndexRefMap.count(offset) != 0;
+	}
+
+	// Total number of entries in the section, including ones not read yet
+	inline int getEntryCount()
+	{
+		return m_entryCount;
+	}
+
+	inline Elf32_Word getSectionSize()
+	{
+		return m_sectionSize;
 	}
 
 	inline Elf32_Off pointerToOffset(char *ptr)
@@ -500,4 +624,6 @@ private:
 	Elf32_Word m_sectionSize;
 
 	std::unordered_map<Elf32_Off, int> m_entryIndexRefMap;
+	int m_entryCount;
+	std::atomic<int> m_readCount;
 };
@@ -65,6 +65,7 @@ typedef uint32_t Elf32_Word;
 #define swap4(x) (((x >> 24) & 0xff) | ((x << 8) & 0xff0000) |\
 	((x >> 8) & 0xff00) | ((x << 24) & 0xff000000))
 #define swap2(x) (((x << 8) & 0xff00) | ((x >> 8) & 0x00ff))
+#define swap8(x) (((uint64_t)swap4((uint32_t)x) << 32) | swap4((uint32_t)(x >> 32)))
 
 struct Elf32_Ehdr
 {
@@ -113,13 +114,15 @@ public:
 	ElfFile(const char *filename)
 	{
 		m_error = ERR_NONE;
+		m_file = nullptr;
 
 		loadFile(filename);
-		initEndian();
 
 		if (m_error)
 			return;
 
+		initEndian();
+
 		Elf32_Ehdr *ehdr = getElfHeader();
 
 		if (ehdr->e_ident[EI_MAG0] != 0x7f ||
@@ -137,6 +140,15 @@ public:
 		}
 	}
 
+	~ElfFile()
+	{
+		delete[] m_file;
+	}
+
+	// The file data is owned, so copies would free it twice
+	ElfFile(const ElfFile&) = delete;
+	ElfFile &operator=(const ElfFile&) = delete;
+
 	inline Elf32_Ehdr* getElfHeader() const
 	{
 		return (Elf32_Ehdr*)m_file;
@@ -154,22 +166,31 @@ public:
 
 	inline Elf32_Shdr* getSectionHeader(Elf32_Half index) const
 	{
-		return (Elf32_Shdr*)(m_file + getElfHeader()->e_shoff) + index;
+		return (Elf32_Shdr*)(m_file + read<Elf32_Off>(&getElfHeader()->e_shoff)) + index;
 	}
 
 	inline char* getSectionName(Elf32_Shdr *shdr) const
 	{
-		return m_file + getSectionHeader(getElfHeader()->e_shstrndx)->sh_offset + shdr->sh_name;
+		Elf32_Shdr *strings = getSectionHeader(read<Elf32_Half>(&getElfHeader()->e_shstrndx));
+
+		return m_file + read<Elf32_Off>(&strings->sh_offset) + read<Elf32_Word>(&shdr->sh_name);
 	}
 
 	inline char* getSectionData(Elf32_Shdr *shdr) const
 	{
-		return m_file + shdr->sh_offset;
+		return m_file + read<Elf32_Off>(&shdr->sh_offset);
+	}
+
+	inline Elf32_Word getSectionSize(Elf32_Shdr *shdr) const
+	{
+		return read<Elf32_Word>(&shdr->sh_size);
 	}
 
 	inline Elf32_Shdr* getSectionHeader(const char *name) const
 	{
-		for (int i = 0; i < getElfHeader()->e_shnum; i++)
+		int count = read<Elf32_Half>(&getElfHeader()->e_shnum);
+
+		for (int i = 0; i < count; i++)
 		{
 			if (strcmp(getSectionName(getSectionHeader(i)), name) == 0)
 				return getSectionHeader(i);
@@ -184,7 +205,7 @@ public:
 	}
 
 	template<class T>
-	inline T read(void *data)
+	inline T read(void *data) const
 	{
 		T x = *(T*)data;
 
@@ -192,8 +213,10 @@ public:
 		{
 			if (sizeof(T) == 2)
 				x = swap2((uint16_t)x);
-			else
+			else if (sizeof(T) == 4)
 				x = swap4((uint32_t)x);
+			else if (sizeof(T) == 8)
+				x = swap8((uint64_t)x);
 		}
 
 		return x;
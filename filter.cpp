@@ -0,0 +1,90 @@
+#include "filter.h"
+
+#include <algorithm>
+
+void SymbolFilter::addUnitPattern(const std::string &pattern)
+{
+	std::string normalized = pattern;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+	m_unitPatterns.push_back(normalized);
+}
+
+bool SymbolFilter::addTypePattern(const std::string &pattern)
+{
+	try
+	{
+		m_typePatterns.emplace_back(pattern, std::regex::ECMAScript | std::regex::optimize);
+	}
+	catch (const std::regex_error &)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool SymbolFilter::matchesUnit(const std::string &filename) const
+{
+	if (m_unitPatterns.empty())
+		return true;
+
+	std::string normalized = filename;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+	for (const std::string &pattern : m_unitPatterns)
+	{
+		if (GlobMatch(pattern.c_str(), normalized.c_str()))
+			return true;
+	}
+
+	return false;
+}
+
+bool SymbolFilter::matchesType(const std::string &name) const
+{
+	if (m_typePatterns.empty())
+		return true;
+
+	for (const std::regex &pattern : m_typePatterns)
+	{
+		if (std::regex_match(name, pattern))
+			return true;
+	}
+
+	return false;
+}
+
+bool SymbolFilter::GlobMatch(const char *pattern, const char *str)
+{
+	// Backtracks to just after the last '*' on a mismatch, which is enough
+	// since a later '*' can always absorb whatever an earlier one would have
+	const char *star = nullptr;
+	const char *resume = nullptr;
+
+	while (*str)
+	{
+		if (*pattern == '*')
+		{
+			star = ++pattern;
+			resume = str;
+		}
+		else if (*pattern == '?' || *pattern == *str)
+		{
+			pattern++;
+			str++;
+		}
+		else if (star)
+		{
+			pattern = star;
+			str = ++resume;
+		}
+		else
+			return false;
+	}
+
+	while (*pattern == '*')
+		pattern++;
+
+	return *pattern == '\0';
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <regex>
+
+// Selects which compile units and types get converted (--cu and --type).
+// Anything matches when no patterns of that kind were given.
+class SymbolFilter
+{
+public:
+	// Unit patterns are globs matched against the whole compile unit path,
+	// with backslashes treated as forward slashes. '*' matches any run of
+	// characters (including '/') and '?' matches one character.
+	void addUnitPattern(const std::string &pattern);
+
+	// Type patterns are ECMAScript regular expressions that have to match
+	// the type's whole name. Returns false if the pattern is invalid.
+	bool addTypePattern(const std::string &pattern);
+
+	bool matchesUnit(const std::string &filename) const;
+	bool matchesType(const std::string &name) const;
+
+	inline bool hasUnitPatterns() const
+	{
+		return !m_unitPatterns.empty();
+	}
+
+	inline bool hasTypePatterns() const
+	{
+		return !m_typePatterns.empty();
+	}
+
+	inline bool isActive() const
+	{
+		return hasUnitPatterns() || hasTypePatterns();
+	}
+
+	static bool GlobMatch(const char *pattern, const char *str);
+
+private:
+	std::vector<std::string> m_unitPatterns;
+	std::vector<std::regex> m_typePatterns;
+};
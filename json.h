@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <cstdio>
+
+// Appends s as a quoted JSON string. Bytes above 0x7f are copied as they
+// are, so names that aren't UTF-8 stay byte for byte the same.
+inline void appendJsonString(std::string &out, const std::string &s)
+{
+	out += '"';
+
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			out += buffer;
+		}
+		else
+			out += c;
+	}
+
+	out += '"';
+}
+
+inline std::string jsonString(const std::string &s)
+{
+	std::string quoted;
+	appendJsonString(quoted, s);
+	return quoted;
+}
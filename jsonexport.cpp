@@ -0,0 +1,359 @@
+#include "jsonexport.h"
+#include "dwarf.h"
+#include "json.h"
+
+#include <cstdio>
+
+namespace Cpp
+{
+
+static const char *kindName(UserType *ut)
+{
+	switch (ut->type)
+	{
+	case UserType::CLASS:
+		return "class";
+	case UserType::UNION:
+		return "union";
+	case UserType::STRUCT:
+		return "struct";
+	case UserType::ENUM:
+		return "enum";
+	case UserType::ARRAY:
+		return "array";
+	case UserType::FUNCTION:
+		return "function";
+	}
+
+	return "";
+}
+
+static const char *modifierKey(Type::Modifier m)
+{
+	switch (m)
+	{
+	case Type::CONST:
+		return "\"const\"";
+	case Type::POINTER_TO:
+		return "\"pointer\"";
+	case Type::REFERENCE_TO:
+		return "\"reference\"";
+	case Type::VOLATILE:
+		return "\"volatile\"";
+	}
+
+	return "null";
+}
+
+void JsonVisitor::emitString(const std::string &s)
+{
+	appendJsonString(m_out.buffer, s);
+}
+
+void JsonVisitor::emitText()
+{
+	appendJsonString(m_out.buffer, m_text.buffer);
+	m_text.clear();
+}
+
+void JsonVisitor::emitNumber(long long x)
+{
+	char digits[24];
+	snprintf(digits, sizeof(digits), "%lld", x);
+	m_out << digits;
+}
+
+// Sizes and alignments of -1 are unknown
+void JsonVisitor::emitSize(int x)
+{
+	if (x < 0)
+		m_out << "null";
+	else
+		m_out << x;
+}
+
+// {"text":"xEnt*","userType":{"file":...,"index":3},"modifiers":["pointer"]}
+// with "fundamental":"int" in place of "userType" for fundamental types
+void JsonVisitor::emitType(Type &type)
+{
+	m_out << "{\"text\":";
+	type.emit(m_text, "");
+	emitText();
+
+	if (type.isFundamentalType)
+	{
+		m_out << ",\"fundamental\":";
+		EmitFundamentalType(m_text, type.fundamentalType);
+		emitText();
+	}
+	else
+	{
+		m_out << ",\"userType\":{\"file\":";
+
+		if (type.userType->file)
+			emitString(type.userType->file->filename);
+		else
+			m_out << "null";
+
+		m_out << ",\"index\":" << type.userType->index << '}';
+	}
+
+	if (!type.modifiers.empty())
+	{
+		m_out << ",\"modifiers\":[";
+
+		for (size_t i = 0; i < type.modifiers.size(); i++)
+			m_out << (i ? "," : "") << modifierKey(type.modifiers[i]);
+
+		m_out << ']';
+	}
+
+	m_out << '}';
+}
+
+void JsonVisitor::emitUserType(UserType *ut)
+{
+	m_out << "{\"index\":" << ut->index << ",\"kind\":\"" << kindName(ut) << "\",\"name\":";
+	emitString(ut->name);
+	m_out << ",\"size\":";
+	emitSize(ut->byteSize);
+	m_out << ",\"alignment\":";
+	emitSize(ut->byteAlignment);
+
+	switch (ut->type)
+	{
+	case UserType::CLASS:
+	case UserType::UNION:
+	case UserType::STRUCT:
+	{
+		ClassType *c = ut->classData;
+
+		m_out << ",\"bases\":[";
+
+		for (size_t i = 0; i < c->inheritances.size(); i++)
+		{
+			m_out << (i ? "," : "") << "{\"offset\":" << c->inheritances[i].offset << ",\"type\":";
+			emitType(c->inheritances[i].type);
+			m_out << '}';
+		}
+
+		m_out << "],\"members\":[";
+
+		for (size_t i = 0; i < c->members.size(); i++)
+		{
+			ClassType::Member &m = c->members[i];
+
+			m_out << (i ? "," : "") << "{\"name\":";
+			emitString(m.name);
+			m_out << ",\"offset\":" << m.offset;
+
+			if (m.bit_size != -1)
+				m_out << ",\"bitOffset\":" << m.bit_offset << ",\"bitSize\":" << m.bit_size;
+
+			m_out << ",\"type\":";
+			emitType(m.type);
+			m_out << '}';
+		}
+
+		m_out << "],\"functions\":[";
+
+		for (size_t i = 0; i < c->functions.size(); i++)
+		{
+			m_out << (i ? "," : "");
+			emitFunction(c->functions[i]);
+		}
+
+		m_out << ']';
+		break;
+	}
+	case UserType::ENUM:
+	{
+		EnumType *e = ut->enumData;
+
+		m_out << ",\"baseType\":";
+		EmitFundamentalType(m_text, e->baseType);
+		emitText();
+		m_out << ",\"elements\":[";
+
+		for (size_t i = 0; i < e->elements.size(); i++)
+		{
+			m_out << (i ? "," : "") << "{\"name\":";
+			emitString(e->elements[i].name);
+			m_out << ",\"value\":";
+			emitNumber(e->elements[i].constValue);
+			m_out << '}';
+		}
+
+		m_out << ']';
+		break;
+	}
+	case UserType::ARRAY:
+	{
+		ArrayType *a = ut->arrayData;
+
+		m_out << ",\"type\":";
+		emitType(a->type);
+		m_out << ",\"dimensions\":[";
+
+		for (size_t i = 0; i < a->dimensions.size(); i++)
+			m_out << (i ? "," : "") << a->dimensions[i].size;
+
+		m_out << ']';
+		break;
+	}
+	case UserType::FUNCTION:
+	{
+		FunctionType *f = ut->functionData;
+
+		m_out << ",\"returnType\":";
+		emitType(f->returnType);
+		m_out << ",\"parameters\":";
+		emitParameters(f->parameters);
+		break;
+	}
+	}
+
+	m_out << '}';
+}
+
+void JsonVisitor::emitParameters(std::vector<FunctionType::Parameter> &parameters)
+{
+	m_out << '[';
+
+	for (size_t i = 0; i < parameters.size(); i++)
+	{
+		m_out << (i ? "," : "") << "{\"name\":";
+		emitString(parameters[i].name);
+		m_out << ",\"type\":";
+		emitType(parameters[i].type);
+		m_out << '}';
+	}
+
+	m_out << ']';
+}
+
+void JsonVisitor::emitVariable(Variable &v)
+{
+	m_out << "{\"name\":";
+	emitString(v.name);
+	m_out << ",\"global\":" << (v.isGlobal ? "true" : "false") << ",\"type\":";
+	emitType(v.type);
+	m_out << '}';
+}
+
+// Line records are the ones emitDefinition() puts in comments: a line number of 0
+// marks the end of the function, and a character of -1 is missing
+void JsonVisitor::emitFunction(Function &f)
+{
+	m_out << "{\"name\":";
+	emitString(f.name);
+	m_out << ",\"mangledName\":";
+	emitString(f.mangledName);
+	m_out << ",\"address\":";
+	emitNumber(f.startAddress);
+	m_out << ",\"global\":" << (f.isGlobal ? "true" : "false") << ",\"owner\":";
+
+	if (f.typeOwner)
+		emitString(f.typeOwner->name);
+	else
+		m_out << "null";
+
+	m_out << ",\"returnType\":";
+	emitType(f.returnType);
+	m_out << ",\"parameters\":";
+	emitParameters(f.parameters);
+	m_out << ",\"locals\":[";
+
+	for (size_t i = 0; i < f.variables.size(); i++)
+	{
+		m_out << (i ? "," : "");
+		emitVariable(f.variables[i]);
+	}
+
+	m_out << "],\"lines\":[";
+
+	if (f.dwarf)
+	{
+		auto range = f.dwarf->lineEntryMap.equal_range(f.startAddress);
+		bool first = true;
+
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			m_out << (first ? "" : ",") << "{\"line\":" << it->second.lineNumber << ",\"character\":" << (int)it->second.charOffset <<
+				",\"offset\":" << it->second.hexAddressOffset << '}';
+			first = false;
+		}
+	}
+
+	m_out << "]}";
+}
+
+JsonVisitor::JsonVisitor(Emitter &out) : m_out(out)
+{
+	m_section = TYPES;
+	m_first = true;
+}
+
+// Sections are opened as their first item comes, and any that had none are
+// written empty when the file ends
+void JsonVisitor::openSection(Section section)
+{
+	while (m_section < section)
+	{
+		m_section = (Section)(m_section + 1);
+		m_out << (m_section == VARIABLES ? "],\n\"variables\":[" : "],\n\"functions\":[");
+		m_first = true;
+	}
+}
+
+// One type, variable or function per line, so the output can also be read
+// a line at a time
+void JsonVisitor::beginItem(Section section)
+{
+	openSection(section);
+
+	m_out << (m_first ? "\n" : ",\n");
+	m_first = false;
+}
+
+void JsonVisitor::beginFile(File *file)
+{
+	m_section = TYPES;
+	m_first = true;
+
+	m_out << "{\"file\":";
+	emitString(file->filename);
+	m_out << ",\n\"types\":[";
+}
+
+void JsonVisitor::visitUserType(UserType *ut)
+{
+	beginItem(TYPES);
+	emitUserType(ut);
+}
+
+void JsonVisitor::visitVariable(Variable &v)
+{
+	beginItem(VARIABLES);
+	emitVariable(v);
+}
+
+void JsonVisitor::visitFunction(Function &f)
+{
+	beginItem(FUNCTIONS);
+	emitFunction(f);
+}
+
+void JsonVisitor::endFile(File * /*file*/)
+{
+	openSection(FUNCTIONS);
+	m_out << "]}\n";
+}
+
+void EmitJson(Emitter &out, File *file, bool justUserTypes)
+{
+	JsonVisitor visitor(out);
+	Walk(file, justUserTypes, { &visitor });
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "cpp.h"
+
+namespace Cpp
+{
+
+// Renders a file's model as a JSON document, for --format json. Unlike the
+// C++ output nothing is left in comments: every type has its size, every
+// member its offset and bit field, every function its address, mangled
+// name and line records. Types refer to user types by file name and index
+// in that file's "types".
+//
+// justUserTypes leaves out the file's variables and functions, like
+// File::emit.
+void EmitJson(Emitter &out, File *file, bool justUserTypes);
+
+// The visitor behind EmitJson, for rendering along with other formats in
+// one walk
+class JsonVisitor : public ModelVisitor
+{
+public:
+	JsonVisitor(Emitter &out);
+
+	void beginFile(File *file) override;
+	void visitUserType(UserType *ut) override;
+	void visitVariable(Variable &v) override;
+	void visitFunction(Function &f) override;
+	void endFile(File *file) override;
+
+private:
+	enum Section { TYPES, VARIABLES, FUNCTIONS };
+
+	Emitter &m_out;
+	Emitter m_text; // strings are rendered here first so they can be escaped
+	Section m_section;
+	bool m_first;
+
+	void openSection(Section section);
+	void beginItem(Section section);
+	void emitString(const std::string &s);
+	void emitText();
+	void emitNumber(long long x);
+	void emitSize(int x);
+	void emitType(Type &type);
+	void emitUserType(UserType *ut);
+	void emitParameters(std::vector<FunctionType::Parameter> &parameters);
+	void emitVariable(Variable &v);
+	void emitFunction(Function &f);
+};
+
+}
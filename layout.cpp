@@ -0,0 +1,255 @@
+#include "layout.h"
+
+#include <algorithm>
+#include <cstdio>
+
+LayoutIndex::LayoutIndex(const std::vector<Cpp::File*> &files)
+{
+	for (Cpp::File *file : files)
+	{
+		for (Cpp::UserType *ut : file->userTypes)
+		{
+			if (ut->type != Cpp::UserType::CLASS && ut->type != Cpp::UserType::STRUCT && ut->type != Cpp::UserType::UNION)
+				continue;
+
+			const Table *table = build(ut);
+
+			if (!table || ut->name.empty())
+				continue;
+
+			// Prefer a definition over an earlier declaration without members
+			const Table *&named = m_tablesByName[ut->name];
+
+			if (!named || (named->fields.empty() && !table->fields.empty()))
+				named = table;
+		}
+	}
+}
+
+const LayoutIndex::Table *LayoutIndex::find(const std::string &name) const
+{
+	auto it = m_tablesByName.find(name);
+	return (it != m_tablesByName.end()) ? it->second : nullptr;
+}
+
+const LayoutIndex::Table *LayoutIndex::build(Cpp::UserType *ut)
+{
+	auto it = m_tables.find(ut);
+
+	if (it != m_tables.end())
+	{
+		// Only malformed data can contain a type by value inside itself
+		if (m_pending.count(ut))
+			return nullptr;
+
+		return &it->second;
+	}
+
+	Table &table = m_tables[ut];
+	m_pending.insert(ut);
+
+	for (Cpp::ClassType::Inheritance &i : ut->classData->inheritances)
+	{
+		if (IsRecord(i.type))
+			addType(table, i.type, i.type.userType->name, i.offset, -1);
+	}
+
+	for (Cpp::ClassType::Member &m : ut->classData->members)
+		addType(table, m.type, m.name, m.offset, m.bit_size);
+
+	std::stable_sort(table.fields.begin(), table.fields.end(), [](const Field &a, const Field &b) {
+		return a.offset < b.offset;
+	});
+
+	size_t leaves = 1;
+
+	while (leaves < table.fields.size())
+		leaves *= 2;
+
+	// Leaves past the last field end at 0, so they never contain an offset
+	table.maxEnd.assign(leaves * 2, 0);
+
+	for (size_t i = 0; i < table.fields.size(); i++)
+		table.maxEnd[leaves + i] = table.fields[i].offset + table.fields[i].size;
+
+	for (size_t node = leaves - 1; node > 0; node--)
+		table.maxEnd[node] = std::max(table.maxEnd[node * 2], table.maxEnd[node * 2 + 1]);
+
+	m_pending.erase(ut);
+
+	return &table;
+}
+
+void LayoutIndex::addType(Table &table, Cpp::Type &type, const std::string &path, int offset, int bitSize)
+{
+	if (IsRecord(type))
+	{
+		const Table *nested = build(type.userType);
+
+		if (nested && !nested->fields.empty())
+		{
+			for (const Field &field : nested->fields)
+			{
+				table.fields.push_back(field);
+				table.fields.back().offset += offset;
+				table.fields.back().path = JoinPath(path, field.path);
+			}
+
+			return;
+		}
+	}
+
+	Field field;
+	field.offset = offset;
+	field.size = type.size();
+	field.path = path;
+	field.type = &type;
+	field.bitSize = bitSize;
+	field.stride = 0;
+	field.element = nullptr;
+
+	if (!type.isFundamentalType && !type.isIndirect() && type.userType->type == Cpp::UserType::ARRAY)
+	{
+		Cpp::ArrayType *array = type.userType->arrayData;
+		int stride = array->type.size();
+		int count = 1;
+
+		for (Cpp::ArrayType::Dimension &d : array->dimensions)
+			count *= d.size;
+
+		if (stride > 0 && count > 0)
+		{
+			field.size = stride * count;
+			field.type = &array->type;
+			field.stride = stride;
+
+			for (Cpp::ArrayType::Dimension &d : array->dimensions)
+				field.dimensions.push_back(d.size);
+
+			if (IsRecord(array->type))
+			{
+				const Table *element = build(array->type.userType);
+
+				if (element && !element->fields.empty())
+					field.element = element;
+			}
+		}
+	}
+
+	// Unknown sizes still cover their first byte
+	if (field.size <= 0)
+		field.size = 1;
+
+	table.fields.push_back(field);
+}
+
+void LayoutIndex::resolve(const Table &table, int offset, std::vector<Match> *matches) const
+{
+	auto it = std::upper_bound(table.fields.begin(), table.fields.end(), offset, [](int offset, const Field &field) {
+		return offset < field.offset;
+	});
+
+	// Every field before it starts at or before offset, so the ones that end
+	// after it are the ones containing it
+	std::vector<const Field*> containing;
+	FindContaining(table, 1, 0, table.maxEnd.size() / 2, it - table.fields.begin(), offset, &containing);
+
+	for (const Field *f : containing)
+	{
+		const Field &field = *f;
+		int delta = offset - field.offset;
+
+		if (!field.stride)
+		{
+			matches->push_back({ field.path, delta, field.type, field.bitSize });
+			continue;
+		}
+
+		int index = delta / field.stride;
+		int within = delta % field.stride;
+
+		// Split the flat element index into one subscript per dimension
+		std::vector<int> subscripts(field.dimensions.size());
+
+		for (size_t d = field.dimensions.size(); d > 0; d--)
+		{
+			subscripts[d - 1] = index % field.dimensions[d - 1];
+			index /= field.dimensions[d - 1];
+		}
+
+		std::string path = field.path;
+
+		for (int s : subscripts)
+			path += "[" + std::to_string(s) + "]";
+
+		size_t first = matches->size();
+
+		if (field.element)
+			resolve(*field.element, within, matches);
+
+		if (matches->size() == first)
+			matches->push_back({ path, within, field.type, -1 });
+		else
+		{
+			for (size_t i = first; i < matches->size(); i++)
+				(*matches)[i].path = JoinPath(path, (*matches)[i].path);
+		}
+	}
+}
+
+// Appends the fields among the first count that end after offset, in order.
+// node covers fields [begin, end).
+void LayoutIndex::FindContaining(const Table &table, size_t node, size_t begin, size_t end, size_t count, int offset,
+	std::vector<const Field*> *containing)
+{
+	if (begin >= count || table.maxEnd[node] <= offset)
+		return;
+
+	if (end - begin == 1)
+	{
+		containing->push_back(&table.fields[begin]);
+		return;
+	}
+
+	size_t middle = (begin + end) / 2;
+
+	FindContaining(table, node * 2, begin, middle, count, offset, containing);
+	FindContaining(table, node * 2 + 1, middle, end, count, offset, containing);
+}
+
+std::string LayoutIndex::MatchToString(const Match &match)
+{
+	if (match.delta == 0)
+		return match.path;
+
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), "+0x%x", match.delta);
+
+	return match.path + buffer;
+}
+
+std::string LayoutIndex::MatchTypeToString(const Match &match)
+{
+	std::string type = match.type->toString();
+
+	if (match.bitSize != -1)
+		type += " : " + std::to_string(match.bitSize);
+
+	return type;
+}
+
+// Members of anonymous structs and unions are reached without a name of
+// their own in between
+std::string LayoutIndex::JoinPath(const std::string &outer, const std::string &inner)
+{
+	return outer.empty() ? inner : outer + "." + inner;
+}
+
+bool LayoutIndex::IsRecord(Cpp::Type &type)
+{
+	if (type.isFundamentalType || type.isIndirect())
+		return false;
+
+	return type.userType->type == Cpp::UserType::CLASS || type.userType->type == Cpp::UserType::STRUCT ||
+		type.userType->type == Cpp::UserType::UNION;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "cpp.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+// Flattened layouts of every class, struct and union, for answering "what
+// is at offset X inside type T" without walking the members by hand.
+//
+// Each table lists the leaf fields of a type in offset order, with members
+// of bases and nested structs pulled up and given paths like "xBase.pos.x".
+// Arrays stay a single entry, so a large buffer doesn't blow up the table;
+// the element index is worked out from the stride when an offset falls
+// inside one, and arrays of structs continue into the element's table to
+// give paths like "arr[3].y".
+//
+// The model's layouts and name caches are filled in while the tables are
+// built, after which lookups only read from it.
+class LayoutIndex
+{
+public:
+	struct Table;
+
+	struct Field
+	{
+		int offset;
+		int size;
+		std::string path;
+		Cpp::Type *type;
+		int bitSize; // -1 if not a bitfield
+
+		// Set for arrays; type is then the element type
+		int stride;
+		std::vector<int> dimensions;
+		const Table *element; // layout of struct elements, or nullptr
+	};
+
+	struct Table
+	{
+		std::vector<Field> fields;
+
+		// A segment tree over fields: node 1 is the root, node n has children
+		// 2n and 2n+1, and the leaves are fields in order from node
+		// maxEnd.size() / 2. Each node holds the furthest end of the fields
+		// under it, so fields containing an offset are found without
+		// stepping over the ones that end before it.
+		std::vector<int> maxEnd;
+	};
+
+	struct Match
+	{
+		std::string path;
+		int delta; // offset into the leaf
+		Cpp::Type *type;
+		int bitSize;
+	};
+
+	LayoutIndex(const std::vector<Cpp::File*> &files);
+
+	// Returns nullptr if there's no class, struct or union with that name.
+	// With several, the first one read with members is used.
+	const Table *find(const std::string &name) const;
+
+	// Appends every leaf containing offset, in offset order. Unions can give
+	// more than one, padding gives none.
+	void resolve(const Table &table, int offset, std::vector<Match> *matches) const;
+
+	// e.g. "pos.x", "arr[3].y+0x2"
+	static std::string MatchToString(const Match &match);
+
+	// e.g. "float", "unsigned int : 3"
+	static std::string MatchTypeToString(const Match &match);
+
+private:
+	std::unordered_map<const Cpp::UserType*, Table> m_tables;
+	std::unordered_map<std::string, const Table*> m_tablesByName;
+	std::unordered_set<const Cpp::UserType*> m_pending;
+
+	const Table *build(Cpp::UserType *ut);
+	void addType(Table &table, Cpp::Type &type, const std::string &path, int offset, int bitSize);
+
+	static void FindContaining(const Table &table, size_t node, size_t begin, size_t end, size_t count, int offset,
+		std::vector<const Field*> *containing);
+	static std::string JoinPath(const std::string &outer, const std::string &inner);
+	static bool IsRecord(Cpp::Type &type);
+};
@@ -1,1017 +1,877 @@
 #include "elf.h"
 #include "dwarf.h"
 #include "cpp.h"
+#include "convert.h"
+#include "output.h"
+#include "queue.h"
+#include "shard.h"
+#include "server.h"
+#include "symbols.h"
+#include "layout.h"
+#include "xref.h"
+#include "stats.h"
+#include "alloc.h"
+#include "trace.h"
+#include "typedb.h"
+#include "jsonexport.h"
 
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <vector>
 #include <map>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
 #include <experimental/filesystem>
 
 namespace filesystem = std::experimental::filesystem;
 
-std::vector<Cpp::File*> cppFiles;
-std::map<Dwarf::Entry*, Cpp::UserType*> entryUTPairs;
-std::map<std::string, std::vector<Cpp::UserType*>> nameUTListPairs;
-
-int currentCompileUnitIndex = 0;
-
-Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename);
-void fixUserTypeNames();
-
-bool processDwarf(Dwarf *dwarf);
-bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp);
-bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var);
-bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type);
-bool processLocationAttr(Dwarf::Attribute *attr, int *location);
-bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u);
-bool processUserType(Dwarf::Entry *entry, Cpp::UserType *u);
-bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c);
-bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m);
-bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_);
-bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e);
-bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size);
-bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f);
-bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p);
-bool processFunction(Dwarf::Entry *entry, Cpp::Function *f);
-bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f);
-bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a);
-bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a);
-void replaceChar(char *str, char ch, char newCh);
-
-static inline std::string toHexString(int x)
+enum OutputFormat
 {
-	std::stringstream ss;
-	ss << std::hex << std::showbase << x;
-	return ss.str();
-}
-
-bool error(std::string errorMessage) {
-	std::cout << "ERROR: " << errorMessage << std::endl;
-	return false;
-}
+	FORMAT_CPP,
+	FORMAT_JSON
+};
+
+// Every format is rendered from the same walk over each file
+static std::vector<OutputFormat> formats = { FORMAT_CPP };
+
+std::string outputPath(Cpp::File *cpp, OutputFormat format);
+void writeFile(OutputWriter *writer, Cpp::File *cpp);
+bool saveShardIndex(const char *outDirectory);
+bool mergeShards(const std::vector<char*> &shardDirectories, OutputWriter *writer);
+bool symbolize(const char *inputPath, const AddressIndex &index);
+bool resolveOffsets(const char *inputPath, const LayoutIndex &index);
+bool convertPipelineUnit(Dwarf *dwarf, OutputWriter *writer, int index);
+bool runPipeline(Dwarf *dwarf, OutputWriter *writer);
 
 int main(int argc, char **argv)
 {
-	if (argc != 3)
-	{
-		std::cout << "Usage: dwarf2cpp <input ELF file> <output directory>";
-		return 1;
-	}
+	bool incremental = false;
+	bool pack = false;
+	bool merge = false;
+	bool serve = false;
+	std::string socketPath;
+	const char *symbolizeInput = nullptr;
+	const char *layoutInput = nullptr;
+	const char *typedbPath = nullptr;
+	bool verify = false;
+	const char *xrefPath = nullptr;
+	bool stats = false;
+	const char *statsJsonPath = nullptr;
+	bool allocStats = false;
+	const char *tracePath = nullptr;
+	bool formatGiven = false;
+	int jobs = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<char*> args;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--incremental")
+			incremental = true;
+		else if (arg == "--pack")
+			pack = true;
+		else if (arg == "--jobs" && i + 1 < argc)
+			jobs = std::max(1, atoi(argv[++i]));
+		else if (arg == "--shard" && i + 1 < argc)
+		{
+			if (!ShardIndex::Parse(argv[++i], &shard, &shardCount))
+			{
+				std::cout << "Invalid shard " << argv[i] << ", expected i/N with 0 <= i < N" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--merge")
+			merge = true;
+		else if (arg == "--format" && i + 1 < argc)
+		{
+			std::string list = argv[++i];
 
-	char *elfFilename = argv[1];
-	char *outDirectory = argv[2];
+			formats.clear();
+			formatGiven = true;
 
-	std::cout << "Loading ELF file " << elfFilename << "..." << std::endl;
+			for (size_t start = 0; start <= list.size();)
+			{
+				size_t end = std::min(list.find(',', start), list.size());
+				std::string format = list.substr(start, end - start);
+				OutputFormat f;
+
+				if (format == "cpp")
+					f = FORMAT_CPP;
+				else if (format == "json")
+					f = FORMAT_JSON;
+				else
+				{
+					std::cout << "Unknown format " << format << ", expected cpp or json" << std::endl;
+					return 1;
+				}
 
-	ElfFile *elf = new ElfFile(elfFilename);
+				if (std::find(formats.begin(), formats.end(), f) == formats.end())
+					formats.push_back(f);
 
-	if (elf->getError()) {
-		std::cout << "Failed to parse " << elfFilename << " as an ELF file. Error Code: " << elf->getError() << std::endl;
-		return 1;
+				start = end + 1;
+			}
+		}
+		else if (arg == "--types-only")
+			typesOnly = true;
+		else if (arg == "--symbolize" && i + 1 < argc)
+			symbolizeInput = argv[++i];
+		else if (arg == "--xref" && i + 1 < argc)
+			xrefPath = argv[++i];
+		else if (arg == "--stats")
+			stats = true;
+		else if (arg == "--stats-json" && i + 1 < argc)
+			statsJsonPath = argv[++i];
+		else if (arg == "--alloc-stats")
+			allocStats = true;
+		else if (arg == "--trace" && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (arg == "--layout" && i + 1 < argc)
+			layoutInput = argv[++i];
+		else if (arg == "--typedb" && i + 1 < argc)
+			typedbPath = argv[++i];
+		else if (arg == "--verify")
+			verify = true;
+		else if (arg == "--serve")
+			serve = true;
+		else if (arg == "--listen" && i + 1 < argc)
+		{
+			serve = true;
+			socketPath = argv[++i];
+		}
+		else if (arg == "--cu" && i + 1 < argc)
+			filter.addUnitPattern(argv[++i]);
+		else if (arg == "--type" && i + 1 < argc)
+		{
+			if (!filter.addTypePattern(argv[++i]))
+			{
+				std::cout << "Invalid type pattern " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			std::cout << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+		else
+			args.push_back(argv[i]);
 	}
 
-	std::cout << "Loading DWARFv1 information..." << std::endl;
+	bool sharded = (shardCount > 1);
 
-	Dwarf *dwarf = new Dwarf(elf);
+	bool standalone = serve || symbolizeInput || layoutInput || typedbPath;
+	int standaloneModes = (int)serve + (int)(symbolizeInput != nullptr) + (int)(layoutInput != nullptr) + (int)(typedbPath != nullptr);
+	size_t expectedArgs = standalone ? 1 : 2;
 
-	if (dwarf->getError()) {
-		std::cout << "Failed to parse DWARF data. Error Code: " << dwarf->getError() << std::endl;
+	if ((merge ? args.size() < 2 : args.size() != expectedArgs) || (pack && incremental) || (sharded && (pack || merge)) ||
+		(standalone && (merge || sharded)) || standaloneModes > 1 || (standalone && xrefPath) || (symbolizeInput && typesOnly) || (verify && !typedbPath) ||
+		((stats || statsJsonPath || allocStats || tracePath || formatGiven) && (standalone || merge)))
+	{
+		std::cout << "Usage: dwarf2cpp [--incremental | --pack] [--jobs N] [--shard i/N] [--types-only] [--cu <glob>] [--type <regex>] [--format <cpp | json>,...] [--xref <file>] [--stats] [--stats-json <file>] [--alloc-stats] [--trace <file>] <input ELF file> <output directory | archive>" << std::endl;
+		std::cout << "       dwarf2cpp [--incremental | --pack] [--jobs N] --merge <shard directory>... <output directory | archive>" << std::endl;
+		std::cout << "       dwarf2cpp [--serve | --listen <socket path>] [--types-only] [--cu <glob>] [--type <regex>] <input ELF file>" << std::endl;
+		std::cout << "       dwarf2cpp --symbolize <address file | -> [--cu <glob>] <input ELF file>" << std::endl;
+		std::cout << "       dwarf2cpp --layout <query file | -> [--types-only] [--cu <glob>] <input ELF file>" << std::endl;
+		std::cout << "       dwarf2cpp --typedb <file> [--verify] [--types-only] [--cu <glob>] <input ELF file>";
 		return 1;
 	}
 
-	std::cout << "Converting DWARFv1 entries to C++ data..." << std::endl;
+	char *outDirectory = args.back();
 
-	if (!processDwarf(dwarf)) {
-		std::cout << "Failed to process DWARF data." << std::endl;
-		return 1;
-	}
+	// The archive or the query responses go to stdout, so keep progress
+	// messages out of it
+	std::streambuf *stdoutBuffer = std::cout.rdbuf();
+
+	if ((pack && strcmp(outDirectory, "-") == 0) || standalone)
+		std::cout.rdbuf(std::cerr.rdbuf());
 
-	std::cout << "Done converting DWARFv1 data!" << std::endl;
-	std::cout << "\tNumber of C++ files: " << cppFiles.size() << std::endl << std::endl;
+	OutputWriter::Mode mode = pack ? OutputWriter::MODE_PACK :
+		(incremental ? OutputWriter::MODE_INCREMENTAL : OutputWriter::MODE_DIRECTORY);
 
-	for (Cpp::File *cpp : cppFiles)
+	if (merge)
 	{
-		size_t pos;
-		while ((pos = cpp->filename.find("\\")) != std::string::npos)
-		{
-			cpp->filename.replace(pos, 1, "/");
-		}
+		args.pop_back();
 
-		filesystem::path filename(cpp->filename);
-		filesystem::path path(outDirectory);
+		std::cout << "Merging " << args.size() << " shards..." << std::endl;
 
-		path /= filename.relative_path();
-		path = path.make_preferred();
+		OutputWriter writer(outDirectory, mode, jobs);
 
-		filesystem::create_directories(path.parent_path());
+		if (!mergeShards(args, &writer) || !writer.finish())
+			return 1;
 
-		std::cout << "Writing file " << path << "..." << std::endl;
+		if (incremental)
+			std::cout << "Wrote " << writer.getWrittenCount() << " files, " << writer.getSkippedCount() << " unchanged." << std::endl;
 
-		std::ofstream file(path);
-		file << cpp->toString(false, false);
-		file.close();
+		std::cout << "Done." << std::endl;
+
+		return 0;
 	}
 
-	std::cout << "Done." << std::endl;
+	char *elfFilename = args[0];
 
-	return 0;
-}
+	if (allocStats)
+		AllocationTracker::Enable();
 
-Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename)
-{
-	*outFilename = nullptr;
+	if (tracePath)
+	{
+		Trace::Enable();
+		Trace::SetThreadName("main");
+	}
 
-	size_t numAttributes = entry->attributes.size();
+	std::cout << "Loading ELF file " << elfFilename << "..." << std::endl;
 
-	for (size_t i = 0; i < numAttributes; i++)
-	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+	RunStats runStats;
+	runStats.beginPhase("load");
 
-		if (attr->name == DW_AT_name)
-		{
-			*outFilename = attr->getString();
-			break;
-		}
-	}
+	ElfFile *elf;
 
-	if (*outFilename)
 	{
-		for (Cpp::File *cpp : cppFiles)
-		{
-			if (cpp->filename == *outFilename)
-				return cpp;
-		}
+		Trace::Span span("load ELF");
+		elf = new ElfFile(elfFilename);
 	}
 
-	return nullptr;
-}
+	if (elf->getError()) {
+		std::cout << "Failed to parse " << elfFilename << " as an ELF file. Error Code: " << elf->getError() << std::endl;
+		return 1;
+	}
 
-void fixUserTypeNames()
-{
-	for (auto const &x : nameUTListPairs)
+	if (symbolizeInput)
 	{
-		bool noname = x.first.empty();
-		bool duplicate = x.second.size() > 1;
+		Dwarf *dwarf = loadDwarf(elf);
 
-		if (noname || duplicate)
-		{
-			for (size_t i = 0; i < x.second.size(); i++)
-			{
-				Cpp::UserType *ut = x.second[i];
-
-				if (noname)
-					ut->name = "type";
+		if (!dwarf)
+			return 1;
 
-				if (duplicate)
-					ut->name += "_" + std::to_string(i);
-			}
+		if (!processDwarf(dwarf)) {
+			std::cout << "Failed to process DWARF data." << std::endl;
+			return 1;
 		}
-	}
-}
 
-bool processDwarf(Dwarf *dwarf)
-{
-	Dwarf::Entry *entry = &dwarf->entries.front();
+		AddressIndex index(cppFiles);
 
-	while (entry)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_compile_unit:
-		{
-			const char *filename;
-			Cpp::File *cpp = findCppFile(entry, &filename);
-
-			bool found = (cpp != nullptr);
-
-			if (!found)
-			{
-				cpp = new Cpp::File;
-				cpp->filename = filename;
-			}
-
-			if (!processCompileUnit(entry, cpp))
-				return error(std::string("Failed to processCompileUnit for '").append(cpp->filename).append("'"));
+		return symbolize(symbolizeInput, index) ? 0 : 1;
+	}
 
-			if (!found)
-				cppFiles.push_back(cpp);
+	if (layoutInput)
+	{
+		Dwarf *dwarf = loadDwarf(elf);
 
-			//std::cout << "Found compile unit " << cpp->filename << std::endl;
-			//std::cout << "\t" << std::to_string(cpp->userTypes.size()) << " user types" << std::endl;
-			//std::cout << "\t" << std::to_string(cpp->variables.size()) << " variables" << std::endl;
+		if (!dwarf)
+			return 1;
 
-			break;
-		}
+		if (!processDwarf(dwarf)) {
+			std::cout << "Failed to process DWARF data." << std::endl;
+			return 1;
 		}
 
-		entry = entry->getSibling();
+		LayoutIndex index(cppFiles);
+
+		return resolveOffsets(layoutInput, index) ? 0 : 1;
 	}
 
-	return true;
-}
+	if (typedbPath)
+	{
+		Dwarf *dwarf = loadDwarf(elf);
 
-bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp)
-{
-	nameUTListPairs.clear();
+		if (!dwarf)
+			return 1;
 
-	Dwarf::Entry *next = entry->getSibling();
-	size_t numAttributes = entry->attributes.size();
+		if (!processDwarf(dwarf)) {
+			std::cout << "Failed to process DWARF data." << std::endl;
+			return 1;
+		}
 
-	for (size_t i = 0; i < numAttributes; i++)
-	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		std::cout << "Writing type database " << typedbPath << "..." << std::endl;
 
-		switch (attr->name)
-		{
-		case DW_AT_name:
-			cpp->filename = attr->getString();
-			break;
-		}
-	}
+		if (!TypeDatabase::Save(cppFiles, typedbPath))
+			return 1;
 
-	Dwarf::Entry *start = ++entry;
+		if (verify && !TypeDatabase::Verify(typedbPath))
+			return 1;
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_class_type:
-		case DW_TAG_structure_type:
-		case DW_TAG_enumeration_type:
-		case DW_TAG_array_type:
-		case DW_TAG_subroutine_type:
-		case DW_TAG_union_type:
-		{
-			entryUTPairs[entry] = new Cpp::UserType;
-		}
-		}
+		std::cout << "Done." << std::endl;
 
-		entry = entry->getSibling();
+		return 0;
 	}
 
-	entry = start;
-
-	while (entry && entry < next)
+	if (serve)
 	{
-		switch (entry->tag)
-		{
-		case DW_TAG_global_variable:
-		case DW_TAG_local_variable:
-		{
-			Cpp::Variable var;
+		Dwarf *dwarf = loadDwarf(elf);
 
-			if (!processVariable(entry, &var))
-				return error("Failed to processVar.");
+		if (!dwarf)
+			return 1;
 
-			cpp->variables.push_back(var);
-			break;
+		if (!processDwarf(dwarf)) {
+			std::cout << "Failed to process DWARF data." << std::endl;
+			return 1;
 		}
-		case DW_TAG_class_type:
-		case DW_TAG_structure_type:
-		case DW_TAG_enumeration_type:
-		case DW_TAG_array_type:
-		case DW_TAG_subroutine_type:
-		case DW_TAG_union_type:
-		{
-			Cpp::UserType *userType = entryUTPairs[entry];
-			processUserType(entry, userType);
 
-			userType->index = cpp->userTypes.size();
-			cpp->userTypes.push_back(userType);
-
-			nameUTListPairs[userType->name].push_back(userType);
-			break;
-		}
-		case DW_TAG_global_subroutine:
-		case DW_TAG_subroutine:
-		case DW_TAG_inlined_subroutine:
+		// Queries are answered on several threads, which mustn't need to
+		// fill in any caches on the model
+		for (Cpp::File *cpp : cppFiles)
 		{
-			Cpp::Function f;
-			f.dwarf = entry->dwarf;
-
-			if (!processFunctionType(entry, &f))
-				return error("Failed to processFunctionType.");
-
-			if (!processFunction(entry, &f))
-				return error("Failed to processFunction.");
-
-			cpp->functions.push_back(f);
-		}
+			Cpp::ComputeLayouts(cpp);
+			Cpp::CacheNameFragments(cpp);
 		}
 
-		entry = entry->getSibling();
-	}
+		QueryServer server(cppFiles);
 
-	fixUserTypeNames();
+		std::cout << "Ready." << std::endl;
 
-	return true;
-}
+		if (!socketPath.empty())
+			return server.listen(socketPath) ? 0 : 1;
 
-bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var)
-{
-	var->isGlobal = (entry->tag == DW_TAG_global_variable);
+		std::ostream responses(stdoutBuffer);
+		server.serve(std::cin, responses);
+
+		return 0;
+	}
 
-	size_t numAttributes = entry->attributes.size();
+	OutputWriter writer(outDirectory, mode, jobs);
+	Dwarf *dwarf;
 
-	for (size_t i = 0; i < numAttributes; i++)
+	if (jobs > 1)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		std::cout << "Converting DWARFv1 entries to C++ data..." << std::endl;
+
+		// Reading, converting and writing overlap, so they're timed together
+		runStats.beginPhase("pipeline");
 
-		switch (attr->name)
 		{
-		case DW_AT_name:
-			var->name = attr->getString();
-			break;
-		case DW_AT_fund_type:
-		case DW_AT_user_def_type:
-		case DW_AT_mod_fund_type:
-		case DW_AT_mod_u_d_type:
-			if (!processTypeAttr(attr, &var->type))
-				return error(std::string("Failed to processTypeAttr for variable '").append(var->name).append("'."));
-			break;
+			Trace::Span span("index .debug");
+			dwarf = new Dwarf(elf, false);
 		}
-	}
 
-	return true;
-}
-
-bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type)
-{
-	Dwarf *dwarf = attr->dwarf;
-
-	switch (attr->name)
-	{
-	case DW_AT_fund_type:
-	{
-		type->isFundamentalType = true;
-		type->fundamentalType = (Cpp::FundamentalType)attr->getHword();
-		break;
+		if (!runPipeline(dwarf, &writer)) {
+			std::cout << "Failed to process DWARF data. Error Code: " << dwarf->getError() << std::endl;
+			writer.finish();
+			return 1;
+		}
 	}
-	case DW_AT_user_def_type:
+	else
 	{
-		type->isFundamentalType = false;
+		runStats.beginPhase("parse");
 
-		if (!findUserType(dwarf, attr->getReference(), &type->userType))
-			return error(std::string("processTypeAttr failed when handling AT_user_def_type."));
+		dwarf = loadDwarf(elf);
 
-		break;
-	}
-	case DW_AT_mod_fund_type:
-	{
-		type->isFundamentalType = true;
+		if (!dwarf)
+			return 1;
 
-		char *mod = attr->getBlock();
-		char *end = mod + attr->size - sizeof(Elf32_Half);
+		std::cout << "Converting DWARFv1 entries to C++ data..." << std::endl;
 
-		type->fundamentalType = (Cpp::FundamentalType)dwarf->read<Elf32_Half>(end);
+		runStats.beginPhase("convert");
 
-		while (mod < end)
-		{
-			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
-			mod++;
+		if (!processDwarf(dwarf)) {
+			std::cout << "Failed to process DWARF data." << std::endl;
+			return 1;
 		}
 
-		break;
-	}
-	case DW_AT_mod_u_d_type:
-	{
-		type->isFundamentalType = false;
-
-		char *mod = attr->getBlock();
-		char *end = mod + attr->size - sizeof(Elf32_Off);
+		std::cout << "Done converting DWARFv1 data!" << std::endl;
+		std::cout << "\tNumber of C++ files: " << cppFiles.size() << std::endl << std::endl;
 
-		if (!findUserType(dwarf, dwarf->read<Elf32_Off>(end), &type->userType))
-			return error(std::string("processTypeAttr failed when handling AT_mod_u_d_type."));
+		runStats.beginPhase("write");
 
-		while (mod < end)
+		// Rendering mustn't fill in any caches on the model, including on
+		// types from files outside the shard that written files refer to
+		for (Cpp::File *cpp : cppFiles)
 		{
-			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
-			mod++;
+			Cpp::ComputeLayouts(cpp);
+			Cpp::CacheNameFragments(cpp);
 		}
 
-		break;
-	}
+		for (Cpp::File *cpp : cppFiles)
+		{
+			if (isInShard(cpp))
+				writeFile(&writer, cpp);
+		}
 	}
 
-	return true;
-}
+	// Files still being written by the pipeline's threads are waited for here
+	if (jobs > 1)
+		runStats.beginPhase("write");
 
-bool processLocationAttr(Dwarf::Attribute *attr, int *location)
-{
-	// I don't really know how location is supposed to be handled,
-	// so I just look for a DW_OP_CONST and use that as the "location"
+	bool finished;
 
-	Dwarf *dwarf = attr->dwarf;
+	{
+		Trace::Span span("wait for writers");
+		finished = writer.finish();
+	}
 
-	char *block = attr->getBlock();
-	char *end = block + attr->size;
+	if (!finished)
+		return 1;
 
-	while (block < end)
+	if (sharded && !saveShardIndex(outDirectory))
+		return 1;
+
+	if (xrefPath)
 	{
-		char op = dwarf->read<char>(block);
-		block += sizeof(char);
+		std::vector<Cpp::File*> written;
 
-		if (op == DW_OP_CONST)
+		for (Cpp::File *cpp : cppFiles)
 		{
-			*location = dwarf->read<Elf32_Word>(block);
-			break;
+			if (isInShard(cpp))
+				written.push_back(cpp);
 		}
-	}
 
-	return true;
-}
+		runStats.beginPhase("xref");
 
-bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u)
-{
-	Dwarf::Entry *entry = dwarf->getEntryFromReference(ref);
+		UsageIndex usages(written);
 
-	if (!entry || entryUTPairs.count(entry) == 0)
-		return error(std::string("Failed to findUserType for reference '").append(std::to_string(ref)).append("'."));
+		std::cout << "Writing " << usages.getUseCount() << " type uses to " << xrefPath << "..." << std::endl;
 
-	*u = entryUTPairs[entry];
+		if (!usages.save(xrefPath))
+			return 1;
+	}
 
-	return true;
-}
+	runStats.endPhase();
 
-bool processUserType(Dwarf::Entry *entry, Cpp::UserType *userType)
-{
-	size_t numAttributes = entry->attributes.size();
+	if (incremental)
+		std::cout << "Wrote " << writer.getWrittenCount() << " files, " << writer.getSkippedCount() << " unchanged." << std::endl;
 
-	for (size_t i = 0; i < numAttributes; i++)
+	if (stats || statsJsonPath)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		runStats.countDwarf(dwarf);
+		runStats.countModel(cppFiles);
+		runStats.countOutput(writer.getRenderedBytes(), writer.getWrittenCount(), writer.getSkippedCount());
 
-		switch (attr->name)
+		if (stats)
 		{
-		case DW_AT_name:
-		{
-			char *name = attr->getString();
-			replaceChar(name, '@', '_');
-			userType->name = name;
-			break;
-		}
+			std::cout << std::endl;
+			runStats.print(std::cout);
+			std::cout << std::endl;
 		}
+
+		if (statsJsonPath && !runStats.saveJson(statsJsonPath))
+			return 1;
 	}
 
-	switch (entry->tag)
+	if (allocStats)
 	{
-	case DW_TAG_class_type:
-	case DW_TAG_structure_type:
-	case DW_TAG_union_type:
-		userType->type = (entry->tag == DW_TAG_structure_type) ? Cpp::UserType::STRUCT : ((entry->tag == DW_TAG_union_type) ? Cpp::UserType::UNION : Cpp::UserType::CLASS);
-		userType->classData = new Cpp::ClassType;
-		userType->classData->parent = userType;
-
-		if (!processClassType(entry, userType->classData))
-			return error(std::string("Failed to processClassType for user type '").append(userType->name).append("'."));
-
-		break;
-	case DW_TAG_enumeration_type:
-		userType->type = Cpp::UserType::ENUM;
-		userType->enumData = new Cpp::EnumType;
-
-		if (!processEnumType(entry, userType->enumData))
-			return error(std::string("Failed to processEnumType for user type '").append(userType->name).append("'."));
-
-		break;
-	case DW_TAG_array_type:
-		userType->type = Cpp::UserType::ARRAY;
-		userType->arrayData = new Cpp::ArrayType;
-
-		if (!processArrayType(entry, userType->arrayData))
-			return error(std::string("Failed to processArrayType for array type '").append(userType->name).append("'."));
-
-		break;
-	case DW_TAG_subroutine_type:
-		userType->type = Cpp::UserType::FUNCTION;
-		userType->functionData = new Cpp::FunctionType;
+		std::cout << std::endl;
+		AllocationTracker::Print(std::cout, 10);
+		std::cout << std::endl;
+	}
 
-		if (!processFunctionType(entry, userType->functionData))
-			return error(std::string("Failed to processFunctionType for function type '").append(userType->name).append("'."));
+	if (tracePath && !Trace::Save(tracePath))
+		return 1;
 
-		break;
-	}
+	std::cout << "Done." << std::endl;
 
-	return true;
+	return 0;
 }
 
-bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c)
+// Path of the file inside the output directory
+std::string outputPath(Cpp::File *cpp, OutputFormat format)
 {
-	c->size = 0;
-
-	size_t numAttributes = entry->attributes.size();
+	std::string filename = cpp->filename;
 
-	for (size_t i = 0; i < numAttributes; i++)
+	size_t pos;
+	while ((pos = filename.find("\\")) != std::string::npos)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
-
-		switch (attr->name)
-		{
-		case DW_AT_byte_size:
-			c->size = attr->getWord();
-			break;
-		}
+		filename.replace(pos, 1, "/");
 	}
 
-	Dwarf::Entry *next = entry->getSibling();
-	Dwarf::Entry *first = entry;
+	std::string path = filesystem::path(filename).relative_path().generic_string();
 
-	int memberCount = 0;
-	entry++;
+	if (format == FORMAT_JSON)
+		path += ".json";
 
-	while (entry && entry < next)
+	return path;
+}
+
+void writeFile(OutputWriter *writer, Cpp::File *cpp)
+{
+	if (filter.isActive())
 	{
-		if (entry->tag == DW_TAG_member)
-			memberCount++;
+		// Types converted on demand were added out of order
+		std::sort(cpp->userTypes.begin(), cpp->userTypes.end(), [](Cpp::UserType *a, Cpp::UserType *b) {
+			return userTypeEntries[a] < userTypeEntries[b];
+		});
 
-		entry = entry->getSibling();
-	}
+		for (size_t i = 0; i < cpp->userTypes.size(); i++)
+			cpp->userTypes[i]->index = i;
 
-	c->members.reserve(memberCount);
-	entry = first + 1;
+		if (filter.hasTypePatterns() && cpp->userTypes.empty())
+			return;
+	}
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_member:
-		{
-			Cpp::ClassType::Member m;
+	std::vector<filesystem::path> paths;
 
-			if (!processMember(entry, &m))
-				return error("Failed to processMember for class type.");
+	for (OutputFormat format : formats)
+		paths.push_back(outputPath(cpp, format));
 
-			c->members.push_back(m);
-			break;
-		}
-		case DW_TAG_inheritance:
-			Cpp::ClassType::Inheritance i;
+	writer->submit(paths, [cpp](Cpp::Emitter *outs) {
+		bool justUserTypes = typesOnly || filter.hasTypePatterns();
 
-			if (!processInheritance(entry, &i))
-				return error("Failed to processInheritance for class type.");
+		std::vector<Cpp::ModelVisitor*> visitors;
 
-			c->inheritances.push_back(i);
-			break;
+		for (size_t i = 0; i < formats.size(); i++)
+		{
+			if (formats[i] == FORMAT_JSON)
+				visitors.push_back(new Cpp::JsonVisitor(outs[i]));
+			else
+				visitors.push_back(new Cpp::CppVisitor(outs[i], justUserTypes, false));
 		}
 
-		entry = entry->getSibling();
-	}
+		Cpp::Walk(cpp, justUserTypes, visitors);
 
-	return true;
+		for (Cpp::ModelVisitor *visitor : visitors)
+			delete visitor;
+	});
 }
 
-bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m)
+bool saveShardIndex(const char *outDirectory)
 {
-	m->bit_offset = -1;
-	m->bit_size = -1;
+	ShardIndex index;
+	index.shard = shard;
+	index.shardCount = shardCount;
+	index.fileCount = cppFiles.size() * formats.size();
 
-	size_t numAttributes = entry->attributes.size();
-
-	for (size_t i = 0; i < numAttributes; i++)
+	for (size_t i = 0; i < cppFiles.size(); i++)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		if (!isInShard(cppFiles[i]))
+			continue;
 
-		switch (attr->name)
+		for (size_t j = 0; j < formats.size(); j++)
 		{
-		case DW_AT_name:
-			m->name = attr->getString();
-			break;
-		case DW_AT_bit_offset:
-			m->bit_offset = attr->getHword();
-			break;
-		case DW_AT_bit_size:
-			m->bit_size = attr->getWord();
-			break;
-		case DW_AT_fund_type:
-		case DW_AT_user_def_type:
-		case DW_AT_mod_fund_type:
-		case DW_AT_mod_u_d_type:
-			if (!processTypeAttr(attr, &m->type))
-				return error(std::string("Failed to processTypeAttr for member '").append(m->name).append("'."));
-			break;
-		case DW_AT_location:
-			if (!processLocationAttr(attr, &m->offset))
-				return error(std::string("Failed to processLocationAttr for member '").append(m->name).append("'."));
+			ShardIndex::File f;
+			f.order = i * formats.size() + j;
+			f.path = outputPath(cppFiles[i], formats[j]);
+
+			index.files.push_back(f);
 		}
 	}
 
-	return true;
+	return index.save(outDirectory);
 }
 
-bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_)
+// Writes the files from every shard's output directory in the order a single
+// run would write them
+bool mergeShards(const std::vector<char*> &shardDirectories, OutputWriter *writer)
 {
-	size_t numAttributes = entry->attributes.size();
+	std::vector<ShardIndex> indices(shardDirectories.size());
+	std::vector<std::pair<int, ShardIndex::File*>> files;
+	std::map<ShardIndex::File*, char*> fileDirectories;
 
-	for (size_t i = 0; i < numAttributes; i++)
+	for (size_t i = 0; i < shardDirectories.size(); i++)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		ShardIndex &index = indices[i];
 
-		switch (attr->name)
-		{
-		case DW_AT_user_def_type:
-			if (!processTypeAttr(attr, &i_->type))
-				return error("Failed to processTypeAttr for inheritance.");
-			break;
-		case DW_AT_location:
-			if (!processLocationAttr(attr, &i_->offset))
-				return error("Failed to processLocationAttr for inheritance.");
-		}
-	}
+		if (!index.load(shardDirectories[i]))
+			return false;
 
-	return true;
-}
+		if (index.shardCount != (int)shardDirectories.size())
+			return error(std::string("Expected ").append(std::to_string(index.shardCount)).append(" shards, got ").append(std::to_string(shardDirectories.size())));
 
-bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e)
-{
-	int byte_size = 0;
-	size_t numAttributes = entry->attributes.size();
+		if (index.fileCount != indices[0].fileCount)
+			return error(std::string("Shard ").append(shardDirectories[i]).append(" was made from a different input"));
 
-	for (size_t i = 0; i < numAttributes; i++)
-	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		for (size_t j = 0; j < i; j++)
+		{
+			if (indices[j].shard == index.shard)
+				return error(std::string("Shard ").append(std::to_string(index.shard)).append(" was given more than once"));
+		}
 
-		switch (attr->name)
+		for (ShardIndex::File &f : index.files)
 		{
-		case DW_AT_byte_size:
-			byte_size = attr->getWord();
-
-			switch (byte_size) {
-			case 1:
-				e->baseType = Cpp::FundamentalType::UNSIGNED_CHAR;
-				break;
-			case 2:
-				e->baseType = Cpp::FundamentalType::UNSIGNED_SHORT;
-				break;
-			case 4:
-				e->baseType = Cpp::FundamentalType::INT;
-				break;
-			case 8:
-				e->baseType = Cpp::FundamentalType::LONG;
-				break;
-			default:
-				return error(std::string("Unknown enum base type size for enum type. (Size: ").append(std::to_string(byte_size)).append(")"));
-				break;
-			}
-			break;
-		case DW_AT_element_list:
-			if (!processElementList(attr, e, byte_size))
-				return error("Failed to processElementList for enum type.");
-			break;
+			files.emplace_back(f.order, &f);
+			fileDirectories[&f] = shardDirectories[i];
 		}
 	}
 
-	return true;
-}
-
-bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size)
-{
-	Dwarf *dwarf = attr->dwarf;
-
-	char *block = attr->getBlock();
-	char *end = block + attr->size;
+	std::sort(files.begin(), files.end());
 
-	while (block < end)
+	for (size_t i = 0; i < files.size(); i++)
 	{
-		Cpp::EnumType::Element element;
+		if (i > 0 && files[i].first == files[i - 1].first)
+			return error("Shards contain the same file more than once");
 
-		if (byte_size == 1) {
-			element.constValue = dwarf->read<unsigned char>(block);
-		}
-		else if (byte_size == 2) {
-			element.constValue = dwarf->read<unsigned short>(block);
-		}
-		else if (byte_size == 4) {
-			element.constValue = dwarf->read<int>(block);
-		}
-		else if (byte_size == 8) {
-			element.constValue = dwarf->read<long>(block);
-		}
-		
-		block += byte_size;
+		ShardIndex::File *f = files[i].second;
+		filesystem::path source = filesystem::path(fileDirectories[f]) / f->path;
 
-		element.name = block;
-		block += element.name.size() + 1;
+		if (!filesystem::exists(source))
+			return error(std::string("Missing shard output file ").append(source.string()));
 
-		e->elements.push_back(element);
+		writer->submit(f->path, [source](Cpp::Emitter &out) {
+			std::ifstream file(source);
+			out.buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		});
 	}
 
 	return true;
 }
 
-bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f)
+// Resolves the addresses in the input (one per line, decimal or 0x hex, "-"
+// for stdin) and prints one line per address to stdout, in input order:
+// address, function+offset and file separated by tabs, or "??" if no
+// function contains the address
+bool symbolize(const char *inputPath, const AddressIndex &index)
 {
-	Dwarf::Entry *next = entry->getSibling();
-	Dwarf::Entry *first = entry;
+	std::ifstream file;
+	std::istream *in = &std::cin;
 
-	int paramCount = 0;
-	entry++;
+	if (strcmp(inputPath, "-") != 0)
+	{
+		file.open(inputPath);
+
+		if (!file)
+			return error(std::string("Failed to open ").append(inputPath));
+
+		in = &file;
+	}
 
-	while (entry && entry < next)
+	std::vector<unsigned int> addresses;
+	std::vector<std::string> invalid; // the line's text if it isn't an address, or empty
+	std::string line;
+
+	while (std::getline(*in, line))
 	{
-		if (entry->tag == DW_TAG_formal_parameter)
-			paramCount++;
+		const char *str = line.c_str();
+		char *end;
+
+		while (*str == ' ' || *str == '\t')
+			str++;
+
+		if (*str == '\0' || *str == '\r')
+			continue;
+
+		addresses.push_back(strtoul(str, &end, 0));
+		invalid.emplace_back();
 
-		entry = entry->getSibling();
+		if (end == str)
+			invalid.back().assign(str, strcspn(str, " \t\r"));
 	}
 
-	f->parameters.reserve(paramCount);
-	entry = first;
+	std::vector<const AddressIndex::Range*> results;
+	index.findAll(addresses, &results);
 
-	size_t numAttributes = entry->attributes.size();
+	// Names are only built once per function, however often it's hit
+	const std::vector<AddressIndex::Range> &ranges = index.getRanges();
+	std::vector<std::string> names(ranges.size());
 
-	for (size_t i = 0; i < numAttributes; i++)
+	std::string out;
+	char buffer[64];
+
+	for (size_t i = 0; i < addresses.size(); i++)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		const AddressIndex::Range *range = invalid[i].empty() ? results[i] : nullptr;
 
-		switch (attr->name)
+		if (invalid[i].empty())
 		{
-		case DW_AT_fund_type:
-		case DW_AT_user_def_type:
-		case DW_AT_mod_fund_type:
-		case DW_AT_mod_u_d_type:
-			if (!processTypeAttr(attr, &f->returnType))
-				return error("Failed to processTypeAttr for function return type.");
-			break;
+			snprintf(buffer, sizeof(buffer), "0x%08x\t", addresses[i]);
+			out += buffer;
+		}
+		else
+		{
+			out += invalid[i];
+			out += '\t';
 		}
-	}
-
-	entry++;
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
+		if (range)
 		{
-		case DW_TAG_formal_parameter:
-			Cpp::FunctionType::Parameter p;
+			std::string &name = names[range - ranges.data()];
 
-			if (!processParameter(entry, &p))
-				return error("Failed to processParameter for function parameter.");
+			if (name.empty())
+				name = AddressIndex::FunctionName(range->function);
 
-			f->parameters.push_back(p);
+			snprintf(buffer, sizeof(buffer), "+0x%x\t", addresses[i] - range->start);
+			out += name;
+			out += buffer;
+			out += range->file->filename;
+			out += '\n';
 		}
+		else
+			out += "??\n";
 
-		entry = entry->getSibling();
+		if (out.size() >= (1 << 20))
+		{
+			fwrite(out.data(), 1, out.size(), stdout);
+			out.clear();
+		}
 	}
 
+	fwrite(out.data(), 1, out.size(), stdout);
+	fflush(stdout);
+
+	std::cout << "Resolved " << addresses.size() << " addresses." << std::endl;
+
 	return true;
 }
 
-bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p)
+// Resolves the queries in the input (one per line, "<type> <offset>", "-" for
+// stdin) and prints one line per member at that offset to stdout, in input
+// order: type, offset, member path and member type separated by tabs, or
+// "??" in place of the path if nothing is there
+bool resolveOffsets(const char *inputPath, const LayoutIndex &index)
 {
-	size_t numAttributes = entry->attributes.size();
+	std::ifstream file;
+	std::istream *in = &std::cin;
 
-	for (size_t i = 0; i < numAttributes; i++)
+	if (strcmp(inputPath, "-") != 0)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		file.open(inputPath);
 
-		switch (attr->name)
-		{
-		case DW_AT_name:
-			p->name = attr->getString();
-			break;
-		case DW_AT_fund_type:
-		case DW_AT_user_def_type:
-		case DW_AT_mod_fund_type:
-		case DW_AT_mod_u_d_type:
-			if (!processTypeAttr(attr, &p->type))
-				return error(std::string("Failed to processTypeAttr for parameter '").append(p->name).append("'."));
-			break;
-		}
+		if (!file)
+			return error(std::string("Failed to open ").append(inputPath));
+
+		in = &file;
 	}
 
-	return true;
-}
+	std::vector<LayoutIndex::Match> matches;
+	std::string line;
+	std::string out;
+	int count = 0;
 
-bool processFunction(Dwarf::Entry *entry, Cpp::Function *f)
-{
-	f->isGlobal = (entry->tag == DW_TAG_global_subroutine);
+	while (std::getline(*in, line))
+	{
+		size_t nameStart = line.find_first_not_of(" \t\r");
 
-	size_t numAttributes = entry->attributes.size();
+		if (nameStart == std::string::npos)
+			continue;
 
-	for (size_t i = 0; i < numAttributes; i++)
-	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		size_t nameEnd = line.find_first_of(" \t\r", nameStart);
+		std::string name = line.substr(nameStart, nameEnd - nameStart);
+		std::string offsetString;
 
-		switch (attr->name)
+		if (nameEnd != std::string::npos)
 		{
-		case DW_AT_name:
-			f->name = attr->getString();
-			break;
-		case DW_AT_mangled_name:
-			f->mangledName = attr->getString();
-			break;
-		case DW_AT_low_pc:
-			f->startAddress = attr->getAddress();
-			break;
+			size_t offsetStart = line.find_first_not_of(" \t", nameEnd);
+			size_t offsetEnd = line.find_first_of(" \t\r", offsetStart);
+
+			if (offsetStart != std::string::npos)
+				offsetString = line.substr(offsetStart, offsetEnd - offsetStart);
 		}
-	}
 
-	Dwarf::Entry *next = entry->getSibling();
+		char *end;
+		long offset = strtol(offsetString.c_str(), &end, 0);
+		const LayoutIndex::Table *table = index.find(name);
 
-	entry++;
+		matches.clear();
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_lexical_block:
-			if (!processLexicalBlock(entry, f))
-				return error(std::string("Failed to processLexicalBlock for function '").append(f->name).append("'."));
-		}
+		if (table && !offsetString.empty() && *end == '\0')
+			index.resolve(*table, (int)offset, &matches);
 
-		entry = entry->getSibling();
-	}
+		std::string prefix = name + '\t' + offsetString + '\t';
 
-	f->typeOwner = nullptr;
-	if (f->parameters.size() > 0 && f->parameters[0].name.compare("this") == 0) {
-		f->typeOwner = f->parameters[0].type.userType;
-		f->parameters.erase(f->parameters.begin());
-		f->typeOwner->classData->functions.push_back(*f);
-	}
-	else if (f->mangledName.size() > 2) {
-		int foundAt = f->mangledName.rfind("__");
-		if (foundAt != -1) {
-			char temp;
-			std::stringstream length;
-			int i;
-			for (i = foundAt + 1; i < f->mangledName.size(); i++) {
-				temp = f->mangledName[i];
-				if (temp >= '0' && temp <= '9') {
-					length << temp;
-				}
-				else {
-					break;
-				}
-			}
+		if (matches.empty())
+			out += prefix + (table ? "??\n" : "?? (unknown type)\n");
 
-			std::string lengthStr = length.str();
-			if (lengthStr.length() > 0) {
-				int lengthCount = std::stoi(lengthStr);
-				if (f->mangledName[i + lengthCount] == 'F') {
-					std::string className = f->mangledName.substr(i, lengthCount);
-
-					// I tried to access this from the named map, but I couldn't for the life of me figure out how to do it. C++ is terrible, no other languages have runtime libraries that silently fail like this. The map is empty even though the code that adds elements to the map is run. Good grief.
-					/*auto it = nameUTListPairs.find(className);
-					if (it != nameUTListPairs.end()) {
-						std::vector<Cpp::UserType*> vector = it->second;
-						if (vector.size() != 1)
-							std::cout << "Couldn't find good type for '" << className << "'. (" << vector.size() << ")" << std::endl;
-					}
-					else {
-						std::cout << "Couldn't find good type for '" << className << "'." << std::endl;
-					}*/
-						
-					
-					Cpp::UserType* type = nullptr;
-					for (std::map<Dwarf::Entry*, Cpp::UserType*>::iterator iter = entryUTPairs.begin(); iter != entryUTPairs.end(); ++iter)
-					{
-						Dwarf::Entry* k = iter->first;
-						Cpp::UserType* value = iter->second;
-						if (value->name.compare(className) == 0) {
-							type = value;
-							break;
-						}
-					}
-
-					if (type != nullptr) {
-						f->typeOwner = type;
-						f->typeOwner->classData->functions.push_back(*f);
-					}
-				}
-			}
-		}
+		for (LayoutIndex::Match &match : matches)
+			out += prefix + LayoutIndex::MatchToString(match) + '\t' + LayoutIndex::MatchTypeToString(match) + '\n';
+
+		count++;
 	}
 
+	fwrite(out.data(), 1, out.size(), stdout);
+	fflush(stdout);
+
+	std::cout << "Resolved " << count << " offsets." << std::endl;
+
 	return true;
 }
 
-bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f)
+// Converts the unit at index and hands the files it created or changed to the
+// writer
+bool convertPipelineUnit(Dwarf *dwarf, OutputWriter *writer, int index)
 {
-	Dwarf::Entry *next = entry->getSibling();
+	Cpp::File *cpp = convertCompileUnit(&dwarf->entries[index]);
 
-	entry++;
+	if (!cpp)
+		return false;
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_global_variable:
-		case DW_TAG_local_variable:
-		{
-			Cpp::Variable v;
-			
-			if (!processVariable(entry, &v))
-				return error(std::string("Failed to processVariable for local var lexical block in function '").append(f->name).append("'."));
+	modifiedFiles.push_back(cpp);
 
-			f->variables.push_back(v);
-			break;
-		}
-		}
-
-		entry = entry->getSibling();
-	}
+	// Rendering happens on the writer's threads, so the caches are filled
+	// for every changed file before any of them is handed over. That includes
+	// files outside the shard, since written files can refer to their types.
+	std::vector<Cpp::File*> ready;
 
-	return true;
-}
+	for (Cpp::File *modified : modifiedFiles)
+	{
+		if (!dispatchedFiles.insert(modified).second)
+			continue;
 
-bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a)
-{
-	size_t numAttributes = entry->attributes.size();
+		Cpp::ComputeLayouts(modified);
+		Cpp::CacheNameFragments(modified);
+		ready.push_back(modified);
+	}
 
-	for (size_t i = 0; i < numAttributes; i++)
+	for (Cpp::File *modified : ready)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
-
-		switch (attr->name)
-		{
-		case DW_AT_ordering:
-			if (attr->getHword() != DW_ORD_row_major) // meh
-				return error(std::string("processArrayType encountered ordering unsupported by dwarf2cpp! (").append(toHexString(attr->getHword())).append(")"));
-			break;
-		case DW_AT_subscr_data:
-			if (!processSubscriptData(attr, a))
-				return error("Failed to processSubscriptData.");
-		}
+		if (isInShard(modified))
+			writeFile(writer, modified);
 	}
 
+	modifiedFiles.clear();
+
 	return true;
 }
 
-bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a)
+// Reads, converts and writes compile units as a pipeline. A reader thread
+// parses units ahead of the converter (this thread), and each file is handed
+// to the writer's threads as soon as its unit has been converted, so output
+// starts appearing right away. The queue only limits how far the reader gets
+// ahead; the parsed entries, line data and model are all kept until exit.
+bool runPipeline(Dwarf *dwarf, OutputWriter *writer)
 {
-	Dwarf *dwarf = attr->dwarf;
-
-	char *block = attr->getBlock();
-	char *end = block + attr->size;
+	if (dwarf->getError())
+		return false;
 
-	while (block < end)
+	// Every file can refer to any line entry, so these are read up front
+	if (!typesOnly)
 	{
-		char format = dwarf->read<char>(block);
-		block += sizeof(char);
-
-		if (format == DW_FMT_ET)
-		{
-			int typeAttrIndex;
-			Dwarf::Attribute *typeAttr;
-			Dwarf::Entry* entry = &dwarf->entries[attr->entryIndex];
-			Elf32_Off offset = dwarf->pointerToOffset(block);
-
-			offset = dwarf->readAttribute(offset, entry, &typeAttrIndex);
-			block = dwarf->offsetToPointer(offset);
+		Trace::Span span("read .line");
+		dwarf->readLines();
+	}
 
-			typeAttr = &entry->attributes[typeAttrIndex];
+	typeRegistry.reset(dwarf->getEntryCount());
 
-			if (!processTypeAttr(typeAttr, &a->type))
-				return error("Failed to processTypeAttr for subscript data DW_FMT_ET.");
+	BoundedQueue<int> units(16);
 
-			break;
-		}
-		else if (format == DW_FMT_FT_C_C)
-		{
-			Elf32_Half fundType = dwarf->read<Elf32_Half>(block);
-			block += sizeof(Elf32_Half);
+	std::thread reader([dwarf, &units] {
+		Trace::SetThreadName("reader");
+		readCompileUnits(dwarf, &units);
+	});
 
-			// Only long indices are supported
-			if (fundType != DW_FT_long)
-				return error(std::string("Subscript data DW_FMT_FT_C_C had unsupported fundamental indice type ").append(toHexString(fundType)).append(" in type '").append(a->toNameString("")).append("'."));
+	pipelineWriter = writer;
 
-			Elf32_Word lowBound = dwarf->read<Elf32_Word>(block);
-			block += sizeof(Elf32_Word);
+	bool ok = true;
+	int index;
 
-			// Only indices starting at 0 are supported
-			if (lowBound != 0)
-				return error(std::string("Subscript data contained indices which did not start at zero! (Start at: '").append(toHexString(lowBound)).append("', Type: '").append(a->toNameString("")).append("')"));
+	if (filter.isActive())
+	{
+		// Types in units the filters skipped are converted when a selected
+		// unit first refers to them, which can be in a unit the reader hasn't
+		// got to yet, so the section is read in full before converting
+		std::vector<int> pending;
 
-			Elf32_Word highBound = dwarf->read<Elf32_Word>(block);
-			block += sizeof(Elf32_Word);
+		while (units.pop(&index))
+			pending.push_back(index);
 
-			Cpp::ArrayType::Dimension dimension;
-			dimension.size = highBound + 1;
+		reader.join();
 
-			a->dimensions.push_back(dimension);
-		}
-		else
+		for (size_t i = 0; i < pending.size() && ok; i++)
+			ok = convertPipelineUnit(dwarf, writer, pending[i]);
+	}
+	else
+	{
+		while (units.pop(&index))
 		{
-			// Only fundamental typed (long) indices and
-			// constant value bounds are supported
-			return error(std::string("Encountered subscript data format unsupported by dwarf2cpp! (").append(toHexString(format)).append(")"));
+			// Keep draining after a failure so the reader doesn't block
+			if (ok)
+				ok = convertPipelineUnit(dwarf, writer, index);
 		}
-	}
 
-	return true;
-}
+		reader.join();
+	}
 
-void replaceChar(char *str, char ch, char newCh)
-{
-	char *end = str + strlen(str);
+	pipelineWriter = nullptr;
 
-	while (str < end)
-	{
-		if (*str == ch)
-			*str = newCh;
-		str++;
-	}
+	return ok && !dwarf->getError();
 }
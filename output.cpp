@@ -0,0 +1,522 @@
+#include "output.h"
+#include "alloc.h"
+#include "trace.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace filesystem = std::experimental::filesystem;
+
+static const char *manifestFilename = ".dwarf2cpp-manifest";
+
+OutputWriter::OutputWriter(const std::string &path, Mode mode, int jobs)
+	: m_queue(jobs * 4)
+{
+	m_mode = mode;
+	m_pack = nullptr;
+	m_failed = false;
+	m_writtenCount = 0;
+	m_skippedCount = 0;
+	m_renderedBytes = 0;
+	m_manifestChanged = false;
+	m_closing = false;
+	m_pending = 0;
+	m_submitCount = 0;
+
+	if (m_mode == MODE_PACK)
+	{
+		if (path == "-")
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			m_pack = stdout;
+		}
+		else
+			m_pack = fopen(path.c_str(), "wb");
+
+		if (!m_pack)
+		{
+			std::cout << "ERROR: Failed to open " << path << std::endl;
+			m_failed = true;
+		}
+		else
+			setvbuf(m_pack, nullptr, _IOFBF, 1 << 20);
+
+		// Honor SOURCE_DATE_EPOCH so reproducible builds can pick the date
+		const char *epoch = getenv("SOURCE_DATE_EPOCH");
+		m_packTime = epoch ? (time_t)strtoll(epoch, nullptr, 10) : 0;
+	}
+	else
+		m_directory = path;
+
+	if (m_mode == MODE_INCREMENTAL)
+		loadManifest();
+
+	if (jobs > 1)
+	{
+		for (int i = 0; i < jobs; i++)
+			m_workers.emplace_back(&OutputWriter::workerMain, this);
+	}
+}
+
+OutputWriter::~OutputWriter()
+{
+	if (!m_closing)
+		finish();
+}
+
+void OutputWriter::submit(const filesystem::path &relativePath, Renderer render)
+{
+	submit(std::vector<filesystem::path>{ relativePath }, [render](Cpp::Emitter *outs) {
+		render(outs[0]);
+	});
+}
+
+void OutputWriter::submit(const std::vector<filesystem::path> &relativePaths, MultiRenderer render)
+{
+	Task task;
+	task.relativePaths = relativePaths;
+	task.render = render;
+	task.sequence = m_submitCount++;
+
+	if (m_mode == MODE_PACK)
+	{
+		std::lock_guard<std::mutex> lock(m_packMutex);
+
+		for (const filesystem::path &relativePath : relativePaths)
+		{
+			std::string name = relativePath.generic_string();
+			auto it = m_packSlots.find(name);
+
+			if (it == m_packSlots.end())
+			{
+				it = m_packSlots.emplace(name, m_packEntries.size()).first;
+
+				PackEntry entry;
+				entry.name = name;
+				entry.sequence = 0;
+				entry.rendered = false;
+				m_packEntries.push_back(std::move(entry));
+			}
+
+			task.packSlots.push_back(it->second);
+		}
+	}
+
+	if (m_workers.empty())
+	{
+		run(task, m_emitters);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		m_pending++;
+	}
+
+	m_queue.push(std::move(task));
+}
+
+void OutputWriter::wait()
+{
+	std::unique_lock<std::mutex> lock(m_pendingMutex);
+	m_idle.wait(lock, [this] { return m_pending == 0; });
+}
+
+bool OutputWriter::finish()
+{
+	m_closing = true;
+	m_queue.close();
+
+	for (std::thread &worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+
+	if (m_mode == MODE_INCREMENTAL)
+	{
+		// Drop files that weren't produced this time
+		for (auto it = m_manifest.begin(); it != m_manifest.end();)
+		{
+			if (m_submittedPaths.count(it->first) == 0)
+			{
+				it = m_manifest.erase(it);
+				m_manifestChanged = true;
+			}
+			else
+				++it;
+		}
+	}
+
+	if (m_mode == MODE_INCREMENTAL && m_manifestChanged && !saveManifest())
+		m_failed = true;
+
+	if (m_mode == MODE_PACK && m_pack && !closePack())
+		m_failed = true;
+
+	std::cout.flush();
+
+	return !m_failed;
+}
+
+void OutputWriter::workerMain()
+{
+	Trace::SetThreadName("writer");
+
+	// Each worker renders into its own buffers, which are reused across files
+	std::vector<Cpp::Emitter> emitters;
+
+	Task task;
+
+	while (m_queue.pop(&task))
+	{
+		run(task, emitters);
+
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+
+		if (--m_pending == 0)
+			m_idle.notify_all();
+	}
+}
+
+// The render span is named after the first file
+void OutputWriter::run(Task &task, std::vector<Cpp::Emitter> &emitters)
+{
+	if (emitters.size() < task.relativePaths.size())
+		emitters.resize(task.relativePaths.size());
+
+	for (size_t i = 0; i < task.relativePaths.size(); i++)
+		emitters[i].clear();
+
+	{
+		AllocationTracker::Scope scope("render");
+		Trace::Span span("render", task.relativePaths[0]);
+		task.render(emitters.data());
+	}
+
+	for (size_t i = 0; i < task.relativePaths.size(); i++)
+	{
+		AllocationTracker::Scope scope("write");
+		Trace::Span span("write", task.relativePaths[i]);
+
+		m_renderedBytes += emitters[i].buffer.size();
+
+		bool ok = (m_mode == MODE_PACK) ?
+			storePacked(task.packSlots[i], task.sequence, emitters[i].buffer) :
+			write(task.relativePaths[i], emitters[i].buffer);
+
+		if (!ok)
+			m_failed = true;
+	}
+}
+
+bool OutputWriter::write(const filesystem::path &relativePath, const std::string &contents)
+{
+	filesystem::path path = m_directory / relativePath;
+	path = path.make_preferred();
+
+	std::string key = relativePath.generic_string();
+	uint64_t hash = 0;
+
+	if (m_mode == MODE_INCREMENTAL)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_manifestMutex);
+			m_submittedPaths.insert(key);
+		}
+
+		hash = Hash(contents.data(), contents.size());
+
+		if (isUnchanged(path, key, contents, hash))
+		{
+			m_skippedCount++;
+			return true;
+		}
+	}
+
+	createDirectories(path.parent_path());
+
+	{
+		std::lock_guard<std::mutex> lock(m_logMutex);
+		std::cout << "Writing file " << path << "...\n";
+	}
+
+	std::ofstream file(path);
+	file.write(contents.data(), contents.size());
+	file.close();
+
+	if (!file)
+	{
+		std::lock_guard<std::mutex> lock(m_logMutex);
+		std::cout << "ERROR: Failed to write " << path << std::endl;
+		return false;
+	}
+
+	m_writtenCount++;
+
+	if (m_mode == MODE_INCREMENTAL)
+	{
+		// The size on disk can differ from the rendered size if the
+		// stream translates newlines, so record what actually got written
+		uintmax_t size = filesystem::file_size(path);
+
+		std::lock_guard<std::mutex> lock(m_manifestMutex);
+		ManifestEntry &entry = m_manifest[key];
+		entry.hash = hash;
+		entry.size = size;
+		m_manifestChanged = true;
+	}
+
+	return true;
+}
+
+bool OutputWriter::isUnchanged(const filesystem::path &path, const std::string &key, const std::string &contents, uint64_t hash)
+{
+	std::error_code ec;
+	uintmax_t size = filesystem::file_size(path, ec);
+
+	if (ec)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_manifestMutex);
+		auto it = m_manifest.find(key);
+
+		if (it != m_manifest.end())
+			return it->second.hash == hash && it->second.size == size;
+	}
+
+	// Not in the manifest (first incremental run, or the manifest was
+	// deleted), so compare against the existing file directly
+	std::ifstream file(path);
+	std::string existing((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (existing != contents)
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_manifestMutex);
+	ManifestEntry &entry = m_manifest[key];
+	entry.hash = hash;
+	entry.size = size;
+	m_manifestChanged = true;
+
+	return true;
+}
+
+void OutputWriter::createDirectories(const filesystem::path &directory)
+{
+	// Most files share a folder with the previous few, so remember which
+	// ones already exist instead of asking the filesystem every time
+	std::lock_guard<std::mutex> lock(m_directoryMutex);
+
+	if (m_createdDirectories.insert(directory.string()).second)
+		filesystem::create_directories(directory);
+}
+
+// Keeps the contents for closePack(). Files can finish rendering out of
+// order, so an older render never replaces a newer one.
+bool OutputWriter::storePacked(size_t slot, uint64_t sequence, const std::string &contents)
+{
+	std::lock_guard<std::mutex> lock(m_packMutex);
+
+	if (!m_pack)
+		return false;
+
+	PackEntry &entry = m_packEntries[slot];
+
+	if (entry.rendered && entry.sequence > sequence)
+		return true;
+
+	entry.contents = contents;
+	entry.sequence = sequence;
+	entry.rendered = true;
+
+	return true;
+}
+
+bool OutputWriter::writePacked(const PackEntry &entry)
+{
+	static const char padding[512] = {};
+
+	const std::string &name = entry.name;
+	const std::string &contents = entry.contents;
+
+	std::cout << "Packing file " << name << "...\n";
+
+	// Names that don't fit a ustar header get a GNU long name record first
+	if (!writePackHeader(name, contents.size(), '0'))
+	{
+		size_t nameSize = name.size() + 1;
+		size_t namePaddingSize = (512 - nameSize % 512) % 512;
+
+		if (!writePackHeader("././@LongLink", nameSize, 'L') ||
+			fwrite(name.c_str(), 1, nameSize, m_pack) != nameSize ||
+			fwrite(padding, 1, namePaddingSize, m_pack) != namePaddingSize ||
+			!writePackHeader(name.substr(0, 100), contents.size(), '0'))
+		{
+			std::cout << "ERROR: Failed to pack " << name << std::endl;
+			return false;
+		}
+	}
+
+	size_t paddingSize = (512 - contents.size() % 512) % 512;
+
+	if (fwrite(contents.data(), 1, contents.size(), m_pack) != contents.size() ||
+		fwrite(padding, 1, paddingSize, m_pack) != paddingSize)
+	{
+		std::cout << "ERROR: Failed to pack " << name << std::endl;
+		return false;
+	}
+
+	m_writtenCount++;
+
+	return true;
+}
+
+// Writes a ustar header block. Returns false without writing anything if
+// the name doesn't fit in the name/prefix fields.
+bool OutputWriter::writePackHeader(const std::string &name, size_t size, char type)
+{
+	char header[512] = {};
+
+	if (name.size() <= 100)
+		memcpy(header, name.data(), name.size());
+	else
+	{
+		// Split at a '/' so the prefix fits in 155 chars and the rest in 100
+		size_t split = name.rfind('/', 155);
+
+		if (split == std::string::npos || name.size() - split - 1 > 100 || split == 0)
+			return false;
+
+		memcpy(header, name.data() + split + 1, name.size() - split - 1);
+		memcpy(header + 345, name.data(), split);
+	}
+
+	snprintf(header + 100, 8, "%07o", 0644);
+	snprintf(header + 108, 8, "%07o", 0);
+	snprintf(header + 116, 8, "%07o", 0);
+	snprintf(header + 124, 12, "%011llo", (unsigned long long)size);
+	snprintf(header + 136, 12, "%011llo", (unsigned long long)m_packTime);
+	header[156] = type;
+	memcpy(header + 257, "ustar", 6);
+	memcpy(header + 263, "00", 2);
+
+	// The checksum is computed with the checksum field filled with spaces
+	unsigned int checksum = 0;
+	memset(header + 148, ' ', 8);
+
+	for (int i = 0; i < 512; i++)
+		checksum += (unsigned char)header[i];
+
+	snprintf(header + 148, 8, "%06o", checksum);
+	header[155] = ' ';
+
+	return fwrite(header, 1, sizeof(header), m_pack) == sizeof(header);
+}
+
+bool OutputWriter::closePack()
+{
+	// An archive ends with two zero blocks
+	static const char end[1024] = {};
+
+	bool ok = true;
+
+	for (PackEntry &entry : m_packEntries)
+	{
+		if (!entry.rendered)
+			continue;
+
+		if (!writePacked(entry))
+		{
+			ok = false;
+			break;
+		}
+
+		std::string().swap(entry.contents);
+	}
+
+	ok = ok && fwrite(end, 1, sizeof(end), m_pack) == sizeof(end);
+
+	if (m_pack == stdout)
+		ok = (fflush(m_pack) == 0) && ok;
+	else
+		ok = (fclose(m_pack) == 0) && ok;
+
+	m_pack = nullptr;
+
+	if (!ok)
+		std::cout << "ERROR: Failed to write archive" << std::endl;
+
+	return ok;
+}
+
+void OutputWriter::loadManifest()
+{
+	std::ifstream file(m_directory / manifestFilename);
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		// <hash> <size> <path>
+		size_t hashEnd = line.find(' ');
+		size_t sizeEnd = (hashEnd == std::string::npos) ? std::string::npos : line.find(' ', hashEnd + 1);
+
+		if (sizeEnd == std::string::npos)
+			continue;
+
+		ManifestEntry entry;
+		entry.hash = strtoull(line.c_str(), nullptr, 16);
+		entry.size = strtoull(line.c_str() + hashEnd + 1, nullptr, 10);
+
+		m_manifest[line.substr(sizeEnd + 1)] = entry;
+	}
+}
+
+bool OutputWriter::saveManifest()
+{
+	createDirectories(m_directory);
+
+	std::ofstream file(m_directory / manifestFilename);
+
+	for (auto const &x : m_manifest)
+	{
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)x.second.hash);
+
+		file << hash << ' ' << x.second.size << ' ' << x.first << '\n';
+	}
+
+	file.close();
+
+	if (!file)
+	{
+		std::cout << "ERROR: Failed to write " << (m_directory / manifestFilename) << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// 64-bit FNV-1a
+uint64_t OutputWriter::Hash(const char *data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
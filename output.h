@@ -0,0 +1,161 @@
+#pragma once
+
+#include "cpp.h"
+#include "queue.h"
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+// Renders and writes files into the output directory.
+//
+// Files are handed to a pool of worker threads through a bounded queue,
+// so rendering and file I/O for several files happen at once while the
+// caller keeps producing work. With a single job everything runs on the
+// calling thread in submission order.
+//
+// In incremental mode a manifest (.dwarf2cpp-manifest) in the output
+// directory records the hash of every file's rendered contents along with
+// its size on disk. Files whose contents haven't changed since the last
+// run are left untouched, so their timestamps stay the same. The manifest
+// is rewritten to list only the files submitted in the current run.
+//
+// In pack mode nothing is written to the output directory; every file goes
+// into a single uncompressed tar archive instead ("-" is stdout). Rendered
+// files are held in memory and written by finish() in the order they were
+// first submitted, with a fixed timestamp, so the archive is the same no
+// matter how many jobs rendered it. A file submitted again replaces its
+// earlier contents.
+class OutputWriter
+{
+public:
+	enum Mode
+	{
+		MODE_DIRECTORY,
+		MODE_INCREMENTAL,
+		MODE_PACK
+	};
+
+	typedef std::function<void(Cpp::Emitter &out)> Renderer;
+
+	// Renders several files at once, into one Emitter per path in order
+	typedef std::function<void(Cpp::Emitter *outs)> MultiRenderer;
+
+	struct ManifestEntry
+	{
+		uint64_t hash;
+		uintmax_t size;
+	};
+
+	// path is the output directory, or the archive in pack mode
+	OutputWriter(const std::string &path, Mode mode, int jobs);
+	~OutputWriter();
+
+	// relativePath is the path of the file inside the output directory.
+	// Blocks while the queue is full.
+	void submit(const std::experimental::filesystem::path &relativePath, Renderer render);
+	void submit(const std::vector<std::experimental::filesystem::path> &relativePaths, MultiRenderer render);
+
+	// Waits until every file submitted so far has been written
+	void wait();
+
+	// Waits for all queued files and saves the manifest or closes the archive.
+	// Returns false if any file failed to write.
+	bool finish();
+
+	inline int getWrittenCount() const
+	{
+		return m_writtenCount;
+	}
+
+	inline int getSkippedCount() const
+	{
+		return m_skippedCount;
+	}
+
+	// Size of everything rendered, including files left unchanged
+	inline uint64_t getRenderedBytes() const
+	{
+		return m_renderedBytes;
+	}
+
+	static uint64_t Hash(const char *data, size_t size);
+
+private:
+	struct Task
+	{
+		std::vector<std::experimental::filesystem::path> relativePaths;
+		MultiRenderer render;
+		uint64_t sequence;
+
+		// Index into m_packEntries for each path, in pack mode
+		std::vector<size_t> packSlots;
+	};
+
+	struct PackEntry
+	{
+		std::string name;
+		std::string contents;
+		uint64_t sequence;
+		bool rendered;
+	};
+
+	std::experimental::filesystem::path m_directory;
+	Mode m_mode;
+	std::atomic<bool> m_failed;
+	std::atomic<int> m_writtenCount;
+	std::atomic<int> m_skippedCount;
+	std::atomic<uint64_t> m_renderedBytes;
+
+	std::map<std::string, ManifestEntry> m_manifest;
+	std::set<std::string> m_submittedPaths;
+	bool m_manifestChanged;
+	std::mutex m_manifestMutex;
+
+	std::set<std::string> m_createdDirectories;
+	std::mutex m_directoryMutex;
+
+	std::mutex m_logMutex;
+
+	FILE *m_pack;
+	time_t m_packTime;
+	std::vector<PackEntry> m_packEntries;
+	std::map<std::string, size_t> m_packSlots;
+	std::mutex m_packMutex;
+
+	uint64_t m_submitCount;
+
+	// Only used when running on the calling thread
+	std::vector<Cpp::Emitter> m_emitters;
+
+	std::vector<std::thread> m_workers;
+	BoundedQueue<Task> m_queue;
+	bool m_closing;
+
+	int m_pending;
+	std::mutex m_pendingMutex;
+	std::condition_variable m_idle;
+
+	void workerMain();
+	void run(Task &task, std::vector<Cpp::Emitter> &emitters);
+	bool write(const std::experimental::filesystem::path &relativePath, const std::string &contents);
+	bool storePacked(size_t slot, uint64_t sequence, const std::string &contents);
+	bool writePacked(const PackEntry &entry);
+	bool writePackHeader(const std::string &name, size_t size, char type);
+	bool closePack();
+	bool isUnchanged(const std::experimental::filesystem::path &path, const std::string &key, const std::string &contents, uint64_t hash);
+	void createDirectories(const std::experimental::filesystem::path &directory);
+	void loadManifest();
+	bool saveManifest();
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Fixed-capacity queue for handing work between threads. push() blocks
+// while the queue is full and pop() blocks until an item arrives or the
+// queue is closed.
+template<class T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(size_t capacity)
+	{
+		m_capacity = capacity;
+		m_closed = false;
+	}
+
+	void push(T item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notFull.wait(lock, [this] { return m_items.size() < m_capacity; });
+
+		m_items.push_back(std::move(item));
+
+		lock.unlock();
+		m_notEmpty.notify_one();
+	}
+
+	// Returns false once the queue is closed and empty
+	bool pop(T *item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+
+		if (m_items.empty())
+			return false;
+
+		*item = std::move(m_items.front());
+		m_items.pop_front();
+
+		lock.unlock();
+		m_notFull.notify_one();
+
+		return true;
+	}
+
+	// Items already queued can still be popped after closing
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closed = true;
+		}
+
+		m_notEmpty.notify_all();
+	}
+
+private:
+	std::deque<T> m_items;
+	size_t m_capacity;
+	bool m_closed;
+	std::mutex m_mutex;
+	std::condition_variable m_notEmpty;
+	std::condition_variable m_notFull;
+};
@@ -0,0 +1,67 @@
+#include "registry.h"
+
+#include <functional>
+#include <mutex>
+
+TypeRegistry::TypeRegistry()
+{
+	m_entryCount = 0;
+}
+
+void TypeRegistry::reset(int entryCount)
+{
+	m_entries.reset(new std::atomic<Cpp::UserType*>[entryCount]);
+	m_entryCount = entryCount;
+
+	for (int i = 0; i < entryCount; i++)
+		m_entries[i].store(nullptr, std::memory_order_relaxed);
+
+	for (NameShard &shard : m_nameShards)
+	{
+		std::unique_lock<std::shared_timed_mutex> lock(shard.mutex);
+		shard.types.clear();
+	}
+}
+
+bool TypeRegistry::insert(int entryIndex, Cpp::UserType *type)
+{
+	if (entryIndex < 0 || entryIndex >= m_entryCount)
+		return false;
+
+	Cpp::UserType *expected = nullptr;
+	return m_entries[entryIndex].compare_exchange_strong(expected, type, std::memory_order_release, std::memory_order_relaxed);
+}
+
+void TypeRegistry::insertName(const std::string &name, int entryIndex, Cpp::UserType *type)
+{
+	NameShard &shard = getNameShard(name);
+	std::unique_lock<std::shared_timed_mutex> lock(shard.mutex);
+
+	auto result = shard.types.emplace(name, std::make_pair(entryIndex, type));
+
+	if (!result.second && entryIndex < result.first->second.first)
+		result.first->second = std::make_pair(entryIndex, type);
+}
+
+Cpp::UserType *TypeRegistry::findByName(const std::string &name) const
+{
+	const NameShard &shard = getNameShard(name);
+	std::shared_lock<std::shared_timed_mutex> lock(shard.mutex);
+
+	auto it = shard.types.find(name);
+
+	if (it == shard.types.end())
+		return nullptr;
+
+	return it->second.second;
+}
+
+TypeRegistry::NameShard &TypeRegistry::getNameShard(const std::string &name)
+{
+	return m_nameShards[std::hash<std::string>()(name) % NAME_SHARD_COUNT];
+}
+
+const TypeRegistry::NameShard &TypeRegistry::getNameShard(const std::string &name) const
+{
+	return m_nameShards[std::hash<std::string>()(name) % NAME_SHARD_COUNT];
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "cpp.h"
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <shared_mutex>
+
+// Maps DWARF entries and type names to the user types converted from them,
+// and can be used by several conversion threads at once.
+//
+// Types are looked up by entry index in a flat table sized for every entry
+// in the section, so those lookups never lock. Each slot can only be set
+// once. Names are spread over a number of independently locked shards; a
+// name maps to the type with the lowest entry index registered under it,
+// so the result doesn't depend on the order threads register types in.
+class TypeRegistry
+{
+public:
+	TypeRegistry();
+
+	// Clears the registry and makes room for entryCount entries
+	void reset(int entryCount);
+
+	// Returns false if a type is already registered for the entry
+	bool insert(int entryIndex, Cpp::UserType *type);
+
+	// Returns nullptr if no type is registered for the entry
+	inline Cpp::UserType *find(int entryIndex) const
+	{
+		if (entryIndex < 0 || entryIndex >= m_entryCount)
+			return nullptr;
+
+		return m_entries[entryIndex].load(std::memory_order_acquire);
+	}
+
+	void insertName(const std::string &name, int entryIndex, Cpp::UserType *type);
+	Cpp::UserType *findByName(const std::string &name) const;
+
+private:
+	enum { NAME_SHARD_COUNT = 64 };
+
+	struct NameShard
+	{
+		mutable std::shared_timed_mutex mutex;
+		std::unordered_map<std::string, std::pair<int, Cpp::UserType*>> types;
+	};
+
+	std::unique_ptr<std::atomic<Cpp::UserType*>[]> m_entries;
+	int m_entryCount;
+
+	NameShard m_nameShards[NAME_SHARD_COUNT];
+
+	NameShard &getNameShard(const std::string &name);
+	const NameShard &getNameShard(const std::string &name) const;
+};
@@ -0,0 +1,350 @@
+#include "server.h"
+
+#include <iostream>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+QueryServer::QueryServer(const std::vector<Cpp::File*> &files) : m_layouts(files), m_usages(files)
+{
+	for (Cpp::File *file : files)
+	{
+		for (Cpp::UserType *ut : file->userTypes)
+		{
+			m_typesByName[ut->name].push_back(ut);
+
+			if (ut->type == Cpp::UserType::CLASS || ut->type == Cpp::UserType::STRUCT || ut->type == Cpp::UserType::UNION)
+			{
+				for (Cpp::ClassType::Member &member : ut->classData->members)
+				{
+					MemberUse use;
+					use.owner = ut;
+					use.member = &member;
+
+					m_membersByType[NormalizeType(member.type.toString())].push_back(use);
+				}
+			}
+		}
+
+		for (Cpp::Function &function : file->functions)
+			m_functionsByAddress[function.startAddress].push_back(&function);
+	}
+}
+
+void QueryServer::serve(std::istream &in, std::ostream &out)
+{
+	Cpp::Emitter response;
+	std::string line;
+
+	while (std::getline(in, line))
+	{
+		response.clear();
+
+		bool keepGoing = handle(line, response);
+
+		response << ".\n";
+		out.write(response.buffer.data(), response.buffer.size());
+		out.flush();
+
+		if (!keepGoing)
+			break;
+	}
+}
+
+bool QueryServer::handle(const std::string &request, Cpp::Emitter &out)
+{
+	size_t start = request.find_first_not_of(" \t\r");
+
+	if (start == std::string::npos)
+		return true;
+
+	size_t commandEnd = request.find_first_of(" \t\r", start);
+	std::string command = request.substr(start, commandEnd - start);
+	std::string argument;
+
+	if (commandEnd != std::string::npos)
+	{
+		size_t argumentStart = request.find_first_not_of(" \t", commandEnd);
+		size_t argumentEnd = request.find_last_not_of(" \t\r");
+
+		if (argumentStart != std::string::npos && argumentEnd >= argumentStart)
+			argument = request.substr(argumentStart, argumentEnd - argumentStart + 1);
+	}
+
+	if (command == "type")
+		findType(argument, out);
+	else if (command == "function")
+		findFunction(argument, out);
+	else if (command == "uses")
+		findUses(argument, out);
+	else if (command == "refs")
+		findRefs(argument, out);
+	else if (command == "offset")
+		findOffset(argument, out);
+	else if (command == "help")
+		out << "type <name>\nfunction <address>\nuses <type>\nrefs <type>\noffset <type> <offset>\nhelp\nquit\n";
+	else if (command == "quit")
+		return false;
+	else
+		out << "error: unknown command '" << command << "'\n";
+
+	return true;
+}
+
+void QueryServer::findType(const std::string &name, Cpp::Emitter &out)
+{
+	auto it = m_typesByName.find(name);
+
+	if (it == m_typesByName.end())
+	{
+		out << "error: no type named '" << name << "'\n";
+		return;
+	}
+
+	for (Cpp::UserType *ut : it->second)
+	{
+		out << "// " << ut->file->filename << '\n';
+
+		// Array and function types only exist as typedefs
+		if (ut->type == Cpp::UserType::ARRAY || ut->type == Cpp::UserType::FUNCTION)
+			ut->emitDeclaration(out);
+		else
+			ut->emitDefinition(out, false);
+
+		out << '\n';
+	}
+}
+
+void QueryServer::findFunction(const std::string &address, Cpp::Emitter &out)
+{
+	char *end;
+	unsigned long value = strtoul(address.c_str(), &end, 0);
+
+	if (address.empty() || *end != '\0')
+	{
+		out << "error: invalid address '" << address << "'\n";
+		return;
+	}
+
+	auto it = m_functionsByAddress.find((unsigned int)value);
+
+	if (it == m_functionsByAddress.end())
+	{
+		out << "error: no function starts at '" << address << "'\n";
+		return;
+	}
+
+	for (Cpp::Function *function : it->second)
+	{
+		function->emitDefinition(out);
+		out << '\n';
+	}
+}
+
+void QueryServer::findUses(const std::string &type, Cpp::Emitter &out)
+{
+	auto it = m_membersByType.find(NormalizeType(type));
+
+	if (it == m_membersByType.end())
+	{
+		out << "error: no members of type '" << type << "'\n";
+		return;
+	}
+
+	for (MemberUse &use : it->second)
+		out << use.owner->name << '\t' << use.member->name << '\t' << use.owner->file->filename << '\n';
+}
+
+void QueryServer::findRefs(const std::string &name, Cpp::Emitter &out)
+{
+	std::vector<const UsageIndex::Use*> uses;
+	m_usages.findByName(name, &uses);
+
+	if (uses.empty())
+	{
+		out << "error: no uses of '" << name << "'\n";
+		return;
+	}
+
+	for (const UsageIndex::Use *use : uses)
+	{
+		out << UsageIndex::KindName(use->kind) << '\t' << use->file->filename << '\t' << UsageIndex::OwnerName(*use) << '\t';
+
+		if (use->name)
+			out << *use->name;
+
+		out << '\n';
+	}
+}
+
+void QueryServer::findOffset(const std::string &query, Cpp::Emitter &out)
+{
+	size_t nameEnd = query.find_first_of(" \t");
+	size_t offsetStart = query.find_first_not_of(" \t", nameEnd);
+
+	if (nameEnd == std::string::npos || offsetStart == std::string::npos)
+	{
+		out << "error: expected '<type> <offset>'\n";
+		return;
+	}
+
+	std::string name = query.substr(0, nameEnd);
+	std::string offsetString = query.substr(offsetStart);
+
+	char *end;
+	long offset = strtol(offsetString.c_str(), &end, 0);
+
+	if (*end != '\0')
+	{
+		out << "error: invalid offset '" << offsetString << "'\n";
+		return;
+	}
+
+	const LayoutIndex::Table *table = m_layouts.find(name);
+
+	if (!table)
+	{
+		out << "error: no class, struct or union named '" << name << "'\n";
+		return;
+	}
+
+	std::vector<LayoutIndex::Match> matches;
+	m_layouts.resolve(*table, (int)offset, &matches);
+
+	if (matches.empty())
+	{
+		out << "error: nothing at offset '" << offsetString << "'\n";
+		return;
+	}
+
+	for (LayoutIndex::Match &match : matches)
+		out << LayoutIndex::MatchToString(match) << '\t' << LayoutIndex::MatchTypeToString(match) << '\n';
+}
+
+bool QueryServer::listen(const std::string &path)
+{
+#ifdef _WIN32
+	std::cout << "ERROR: Unix sockets aren't supported on this platform" << std::endl;
+	return false;
+#else
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		std::cout << "ERROR: Socket path " << path << " is too long" << std::endl;
+		return false;
+	}
+
+	strcpy(address.sun_path, path.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	// A socket file left behind by an earlier run would make bind fail
+	unlink(path.c_str());
+
+	if (fd < 0 || bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(fd, 16) != 0)
+	{
+		std::cout << "ERROR: Failed to listen on " << path << ": " << strerror(errno) << std::endl;
+
+		if (fd >= 0)
+			close(fd);
+
+		return false;
+	}
+
+	// Clients going away mid-response shouldn't end the server
+	signal(SIGPIPE, SIG_IGN);
+
+	std::cout << "Listening on " << path << std::endl;
+
+	while (true)
+	{
+		int connection = accept(fd, nullptr, nullptr);
+
+		if (connection < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			std::cout << "ERROR: Failed to accept a connection: " << strerror(errno) << std::endl;
+			close(fd);
+			return false;
+		}
+
+		std::thread(&QueryServer::serveConnection, this, connection).detach();
+	}
+#endif
+}
+
+void QueryServer::serveConnection(int fd)
+{
+#ifndef _WIN32
+	Cpp::Emitter response;
+	std::string pending;
+	char buffer[4096];
+	bool open = true;
+
+	while (open)
+	{
+		ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+
+		if (count <= 0)
+			break;
+
+		pending.append(buffer, count);
+
+		size_t lineEnd;
+		while (open && (lineEnd = pending.find('\n')) != std::string::npos)
+		{
+			response.clear();
+
+			open = handle(pending.substr(0, lineEnd), response);
+			pending.erase(0, lineEnd + 1);
+
+			response << ".\n";
+
+			const char *data = response.buffer.data();
+			size_t remaining = response.buffer.size();
+
+			while (remaining > 0)
+			{
+				ssize_t sent = send(fd, data, remaining, 0);
+
+				if (sent <= 0)
+				{
+					open = false;
+					break;
+				}
+
+				data += sent;
+				remaining -= sent;
+			}
+		}
+	}
+
+	close(fd);
+#endif
+}
+
+std::string QueryServer::NormalizeType(const std::string &type)
+{
+	std::string normalized;
+
+	for (char c : type)
+	{
+		if (!isspace((unsigned char)c))
+			normalized += c;
+	}
+
+	return normalized;
+}
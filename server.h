@@ -0,0 +1,74 @@
+#pragma once
+
+#include "cpp.h"
+#include "layout.h"
+#include "xref.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <istream>
+#include <ostream>
+
+// Answers line-based queries about a converted program, for tools that
+// would otherwise have to run a full conversion and search the output.
+//
+// Each request is a single line, "<command> <argument>". The response is
+// any number of lines followed by a line containing only ".". Errors are
+// reported as a line starting with "error: ".
+//
+//   type <name>          definition of every type with that name
+//   function <address>   definition of the function starting at address
+//   uses <type>          every member of a class/struct/union declared with
+//                        that type (e.g. "xEnt*"), as owner<TAB>member<TAB>file
+//   refs <type>          every base, member, variable, return type, parameter
+//                        and local using the named type, directly or through
+//                        pointers and arrays, as kind<TAB>file<TAB>owner<TAB>name
+//   offset <type> <off>  members of the type at that offset, as path<TAB>type
+//                        (e.g. "arr[3].y+0x2<TAB>float")
+//   help                 list of commands
+//   quit                 ends the session
+//
+// The model must be complete, with layouts and name caches filled in, before
+// the server is created. It's only read from afterwards, so connections on
+// the Unix socket are served on their own threads.
+class QueryServer
+{
+public:
+	QueryServer(const std::vector<Cpp::File*> &files);
+
+	// Answers requests from in until it's exhausted or "quit" is received
+	void serve(std::istream &in, std::ostream &out);
+
+	// Accepts connections on a Unix domain socket at path until the process
+	// is ended. Returns false if the socket couldn't be set up.
+	bool listen(const std::string &path);
+
+	// Appends the response to request, without the terminating line.
+	// Returns false if the session should end.
+	bool handle(const std::string &request, Cpp::Emitter &out);
+
+private:
+	struct MemberUse
+	{
+		Cpp::UserType *owner;
+		Cpp::ClassType::Member *member;
+	};
+
+	std::unordered_map<std::string, std::vector<Cpp::UserType*>> m_typesByName;
+	std::map<unsigned int, std::vector<Cpp::Function*>> m_functionsByAddress;
+	std::unordered_map<std::string, std::vector<MemberUse>> m_membersByType;
+	LayoutIndex m_layouts;
+	UsageIndex m_usages;
+
+	void findType(const std::string &name, Cpp::Emitter &out);
+	void findFunction(const std::string &address, Cpp::Emitter &out);
+	void findUses(const std::string &type, Cpp::Emitter &out);
+	void findOffset(const std::string &query, Cpp::Emitter &out);
+	void findRefs(const std::string &name, Cpp::Emitter &out);
+	void serveConnection(int fd);
+
+	// Type strings are compared with whitespace removed
+	static std::string NormalizeType(const std::string &type);
+};
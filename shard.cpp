@@ -0,0 +1,85 @@
+#include "shard.h"
+#include "output.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+namespace filesystem = std::experimental::filesystem;
+
+static const char *indexFilename = ".dwarf2cpp-shard";
+
+ShardIndex::ShardIndex()
+{
+	shard = 0;
+	shardCount = 1;
+	fileCount = 0;
+}
+
+bool ShardIndex::load(const filesystem::path &directory)
+{
+	std::ifstream file(directory / indexFilename);
+	std::string line;
+
+	files.clear();
+
+	// shard <i>/<N> <file count>
+	if (!std::getline(file, line) || sscanf(line.c_str(), "shard %d/%d %d", &shard, &shardCount, &fileCount) != 3)
+	{
+		std::cout << "ERROR: " << directory << " is not the output of a --shard run" << std::endl;
+		return false;
+	}
+
+	while (std::getline(file, line))
+	{
+		// <order> <path>
+		size_t orderEnd = line.find(' ');
+
+		if (orderEnd == std::string::npos)
+			continue;
+
+		File f;
+		f.order = atoi(line.c_str());
+		f.path = line.substr(orderEnd + 1);
+
+		files.push_back(f);
+	}
+
+	return true;
+}
+
+bool ShardIndex::save(const filesystem::path &directory)
+{
+	std::ofstream file(directory / indexFilename);
+
+	file << "shard " << shard << '/' << shardCount << ' ' << fileCount << '\n';
+
+	for (File &f : files)
+		file << f.order << ' ' << f.path << '\n';
+
+	file.close();
+
+	if (!file)
+	{
+		std::cout << "ERROR: Failed to write " << (directory / indexFilename) << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool ShardIndex::Parse(const char *spec, int *shard, int *shardCount)
+{
+	char end;
+
+	if (sscanf(spec, "%d/%d%c", shard, shardCount, &end) != 2)
+		return false;
+
+	return *shardCount > 0 && *shard >= 0 && *shard < *shardCount;
+}
+
+int ShardIndex::Select(const std::string &filename, int shardCount)
+{
+	return (int)(OutputWriter::Hash(filename.data(), filename.size()) % (uint64_t)shardCount);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+// Describes the output of a --shard run. Saved as .dwarf2cpp-shard in the
+// shard's output directory so --merge can check that every shard is there
+// and write the files back out in the order a single run would have.
+//
+// Compile units are assigned to shards by their file name, so every unit
+// that contributes to an output file ends up in the same shard.
+class ShardIndex
+{
+public:
+	struct File
+	{
+		// Position of the file in a single run's output
+		int order;
+		std::string path;
+	};
+
+	int shard;
+	int shardCount;
+	int fileCount;
+	std::vector<File> files;
+
+	ShardIndex();
+
+	bool load(const std::experimental::filesystem::path &directory);
+	bool save(const std::experimental::filesystem::path &directory);
+
+	// Parses "i/N"
+	static bool Parse(const char *spec, int *shard, int *shardCount);
+
+	// Which of shardCount shards converts and writes the given compile unit
+	static int Select(const std::string &filename, int shardCount);
+};
@@ -0,0 +1,353 @@
+#include "stats.h"
+#include "alloc.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+static const char *userTypeKindNames[6] = { "class", "union", "struct", "enum", "array", "function" };
+
+static double wallTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RunStats::RunStats()
+{
+	m_inPhase = false;
+	m_phaseWallStart = 0.0;
+	m_phaseCpuStart = 0.0;
+	m_entryCount = 0;
+	m_undecodedCount = 0;
+	m_lineCount = 0;
+	m_fileCount = 0;
+	m_functionCount = 0;
+	m_variableCount = 0;
+	m_renderedBytes = 0;
+	m_writtenCount = 0;
+	m_skippedCount = 0;
+
+	for (size_t &count : m_userTypesByKind)
+		count = 0;
+}
+
+void RunStats::beginPhase(const std::string &name)
+{
+	endPhase();
+
+	m_phases.push_back({ name, 0.0, 0.0 });
+	m_inPhase = true;
+	m_phaseWallStart = wallTime();
+	m_phaseCpuStart = CpuTime();
+
+	AllocationTracker::SetPhase(name);
+}
+
+void RunStats::endPhase()
+{
+	if (!m_inPhase)
+		return;
+
+	m_phases.back().wallTime = wallTime() - m_phaseWallStart;
+	m_phases.back().cpuTime = CpuTime() - m_phaseCpuStart;
+	m_inPhase = false;
+}
+
+void RunStats::countDwarf(Dwarf *dwarf)
+{
+	m_entryCount = dwarf->getEntryCount();
+	m_lineCount = dwarf->lineEntryMap.size();
+
+	for (Dwarf::Entry &entry : dwarf->entries)
+	{
+		if (!entry.decoded)
+		{
+			m_undecodedCount++;
+			continue;
+		}
+
+		m_entriesByTag[entry.tag]++;
+
+		for (Dwarf::Attribute &attr : entry.attributes)
+			m_attributesByForm[attr.getForm()]++;
+	}
+
+	// The pipeline stops reading at the first error, and entries the --cu
+	// filter skipped aren't always added to the list
+	m_undecodedCount += m_entryCount - dwarf->entries.size();
+}
+
+void RunStats::countModel(const std::vector<Cpp::File*> &files)
+{
+	m_fileCount = files.size();
+
+	for (Cpp::File *file : files)
+	{
+		for (Cpp::UserType *ut : file->userTypes)
+			m_userTypesByKind[ut->type]++;
+
+		m_functionCount += file->functions.size();
+		m_variableCount += file->variables.size();
+	}
+}
+
+void RunStats::countOutput(uint64_t renderedBytes, int writtenCount, int skippedCount)
+{
+	m_renderedBytes = renderedBytes;
+	m_writtenCount = writtenCount;
+	m_skippedCount = skippedCount;
+}
+
+void RunStats::print(std::ostream &out) const
+{
+	char line[128];
+	double totalWall = 0.0;
+	double totalCpu = 0.0;
+
+	snprintf(line, sizeof(line), "%-24s %12s %12s", "Phase", "Wall (s)", "CPU (s)");
+	out << line << "\n";
+
+	for (const Phase &phase : m_phases)
+	{
+		snprintf(line, sizeof(line), "%-24s %12.3f %12.3f", phase.name.c_str(), phase.wallTime, phase.cpuTime);
+		out << line << "\n";
+
+		totalWall += phase.wallTime;
+		totalCpu += phase.cpuTime;
+	}
+
+	snprintf(line, sizeof(line), "%-24s %12.3f %12.3f", "total", totalWall, totalCpu);
+	out << line << "\n\n";
+
+	auto count = [&](const std::string &name, uint64_t value) {
+		snprintf(line, sizeof(line), "%-24s %12llu", name.c_str(), (unsigned long long)value);
+		out << line << "\n";
+	};
+
+	count("Entries", m_entryCount);
+
+	for (auto &tag : m_entriesByTag)
+		count("  " + TagName(tag.first), tag.second);
+
+	if (m_undecodedCount)
+		count("  (undecoded)", m_undecodedCount);
+
+	size_t attributeCount = 0;
+
+	for (auto &form : m_attributesByForm)
+		attributeCount += form.second;
+
+	count("Attributes", attributeCount);
+
+	for (auto &form : m_attributesByForm)
+		count(std::string("  ") + FormName(form.first), form.second);
+
+	count("Line records", m_lineCount);
+
+	size_t userTypeCount = 0;
+
+	for (size_t kind : m_userTypesByKind)
+		userTypeCount += kind;
+
+	count("User types", userTypeCount);
+
+	for (int i = 0; i < 6; i++)
+		count(std::string("  ") + userTypeKindNames[i], m_userTypesByKind[i]);
+
+	count("Functions", m_functionCount);
+	count("Variables", m_variableCount);
+	count("Files converted", m_fileCount);
+	count("Files written", m_writtenCount);
+
+	if (m_skippedCount)
+		count("Files unchanged", m_skippedCount);
+
+	count("Bytes rendered", m_renderedBytes);
+	count("Peak memory (bytes)", PeakMemory());
+
+	out.flush();
+}
+
+bool RunStats::saveJson(const std::string &path) const
+{
+	std::ofstream file(path);
+
+	file << "{\n\t\"phases\": [";
+
+	for (size_t i = 0; i < m_phases.size(); i++)
+	{
+		file << (i ? ",\n" : "\n") << "\t\t{ \"name\": \"" << m_phases[i].name << "\", \"wall\": " << m_phases[i].wallTime <<
+			", \"cpu\": " << m_phases[i].cpuTime << " }";
+	}
+
+	file << "\n\t],\n";
+	file << "\t\"entries\": " << m_entryCount << ",\n";
+	file << "\t\"undecodedEntries\": " << m_undecodedCount << ",\n";
+	file << "\t\"entriesByTag\": {";
+
+	bool first = true;
+
+	for (auto &tag : m_entriesByTag)
+	{
+		file << (first ? " " : ", ") << "\"" << TagName(tag.first) << "\": " << tag.second;
+		first = false;
+	}
+
+	file << " },\n\t\"attributesByForm\": {";
+	first = true;
+
+	for (auto &form : m_attributesByForm)
+	{
+		file << (first ? " " : ", ") << "\"" << FormName(form.first) << "\": " << form.second;
+		first = false;
+	}
+
+	file << " },\n\t\"lineRecords\": " << m_lineCount << ",\n";
+	file << "\t\"userTypesByKind\": {";
+
+	for (int i = 0; i < 6; i++)
+		file << (i ? ", " : " ") << "\"" << userTypeKindNames[i] << "\": " << m_userTypesByKind[i];
+
+	file << " },\n";
+	file << "\t\"functions\": " << m_functionCount << ",\n";
+	file << "\t\"variables\": " << m_variableCount << ",\n";
+	file << "\t\"filesConverted\": " << m_fileCount << ",\n";
+	file << "\t\"filesWritten\": " << m_writtenCount << ",\n";
+	file << "\t\"filesUnchanged\": " << m_skippedCount << ",\n";
+	file << "\t\"bytesRendered\": " << m_renderedBytes << ",\n";
+	file << "\t\"peakMemory\": " << PeakMemory();
+
+	if (AllocationTracker::IsEnabled())
+	{
+		file << ",\n\t";
+		AllocationTracker::WriteJson(file);
+	}
+
+	file << "\n}\n";
+
+	file.close();
+
+	if (!file)
+	{
+		std::cout << "ERROR: Failed to write " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+uint64_t RunStats::PeakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+double RunStats::CpuTime()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0.0;
+
+	// 100 ns units
+	auto seconds = [](const FILETIME &t) {
+		return (((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) / 1e7;
+	};
+
+	return seconds(kernel) + seconds(user);
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+std::string RunStats::TagName(Elf32_Half tag)
+{
+	switch (tag)
+	{
+	case DW_TAG_padding: return "padding";
+	case DW_TAG_array_type: return "array_type";
+	case DW_TAG_class_type: return "class_type";
+	case DW_TAG_entry_point: return "entry_point";
+	case DW_TAG_enumeration_type: return "enumeration_type";
+	case DW_TAG_formal_parameter: return "formal_parameter";
+	case DW_TAG_global_subroutine: return "global_subroutine";
+	case DW_TAG_global_variable: return "global_variable";
+	case DW_TAG_label: return "label";
+	case DW_TAG_lexical_block: return "lexical_block";
+	case DW_TAG_local_variable: return "local_variable";
+	case DW_TAG_member: return "member";
+	case DW_TAG_pointer_type: return "pointer_type";
+	case DW_TAG_reference_type: return "reference_type";
+	case DW_TAG_compile_unit: return "compile_unit";
+	case DW_TAG_string_type: return "string_type";
+	case DW_TAG_structure_type: return "structure_type";
+	case DW_TAG_subroutine: return "subroutine";
+	case DW_TAG_subroutine_type: return "subroutine_type";
+	case DW_TAG_typedef: return "typedef";
+	case DW_TAG_union_type: return "union_type";
+	case DW_TAG_unspecified_parameters: return "unspecified_parameters";
+	case DW_TAG_variant: return "variant";
+	case DW_TAG_common_block: return "common_block";
+	case DW_TAG_common_inclusion: return "common_inclusion";
+	case DW_TAG_inheritance: return "inheritance";
+	case DW_TAG_inlined_subroutine: return "inlined_subroutine";
+	case DW_TAG_module: return "module";
+	case DW_TAG_ptr_to_member_type: return "ptr_to_member_type";
+	case DW_TAG_set_type: return "set_type";
+	case DW_TAG_subrange_type: return "subrange_type";
+	case DW_TAG_with_stmt: return "with_stmt";
+	}
+
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), "0x%04x", tag);
+
+	return buffer;
+}
+
+const char *RunStats::FormName(Elf32_Half form)
+{
+	switch (form)
+	{
+	case DW_FORM_ADDR: return "addr";
+	case DW_FORM_REF: return "ref";
+	case DW_FORM_BLOCK2: return "block2";
+	case DW_FORM_BLOCK4: return "block4";
+	case DW_FORM_DATA2: return "data2";
+	case DW_FORM_DATA4: return "data4";
+	case DW_FORM_DATA8: return "data8";
+	case DW_FORM_STRING: return "string";
+	}
+
+	return "unknown";
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "dwarf.h"
+#include "cpp.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <cstdint>
+
+// Timings and counts for --stats, for sizing runs on new builds.
+//
+// Phases are timed back to back: starting one ends the previous one. Wall
+// time is measured on the main thread, CPU time is that of the whole
+// process, so a phase that keeps several threads busy uses more CPU than
+// wall time.
+class RunStats
+{
+public:
+	RunStats();
+
+	void beginPhase(const std::string &name);
+	void endPhase();
+
+	// Entries by tag, attributes by form and line records. Entries the --cu
+	// filter skipped over are counted as undecoded.
+	void countDwarf(Dwarf *dwarf);
+
+	// User types by kind, functions and variables
+	void countModel(const std::vector<Cpp::File*> &files);
+
+	void countOutput(uint64_t renderedBytes, int writtenCount, int skippedCount);
+
+	void print(std::ostream &out) const;
+	bool saveJson(const std::string &path) const;
+
+	// Bytes, or 0 where it can't be measured
+	static uint64_t PeakMemory();
+
+	// Seconds of CPU time used by every thread of the process so far
+	static double CpuTime();
+
+	static std::string TagName(Elf32_Half tag);
+	static const char *FormName(Elf32_Half form);
+
+private:
+	struct Phase
+	{
+		std::string name;
+		double wallTime;
+		double cpuTime;
+	};
+
+	std::vector<Phase> m_phases;
+	bool m_inPhase;
+	double m_phaseWallStart;
+	double m_phaseCpuStart;
+
+	size_t m_entryCount;
+	size_t m_undecodedCount;
+	std::map<Elf32_Half, size_t> m_entriesByTag;
+	std::map<Elf32_Half, size_t> m_attributesByForm;
+	size_t m_lineCount;
+
+	size_t m_fileCount;
+	size_t m_userTypesByKind[6];
+	size_t m_functionCount;
+	size_t m_variableCount;
+
+	uint64_t m_renderedBytes;
+	int m_writtenCount;
+	int m_skippedCount;
+};
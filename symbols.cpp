@@ -0,0 +1,105 @@
+#include "symbols.h"
+#include "dwarf.h"
+
+#include <algorithm>
+
+AddressIndex::AddressIndex(const std::vector<Cpp::File*> &files)
+{
+	for (Cpp::File *file : files)
+	{
+		for (Cpp::Function &function : file->functions)
+		{
+			Range range;
+			range.start = function.startAddress;
+			range.end = 0;
+			range.function = &function;
+			range.file = file;
+
+			if (function.dwarf)
+			{
+				auto lines = function.dwarf->lineEntryMap.equal_range(function.startAddress);
+
+				for (auto it = lines.first; it != lines.second; ++it)
+				{
+					if (it->second.lineNumber == 0)
+					{
+						range.end = function.startAddress + it->second.hexAddressOffset + 4;
+						break;
+					}
+				}
+			}
+
+			m_ranges.push_back(range);
+		}
+	}
+
+	// Functions that appear in more than one unit keep their first entry
+	std::stable_sort(m_ranges.begin(), m_ranges.end(), [](const Range &a, const Range &b) {
+		return a.start < b.start;
+	});
+
+	m_ranges.erase(std::unique(m_ranges.begin(), m_ranges.end(), [](const Range &a, const Range &b) {
+		return a.start == b.start;
+	}), m_ranges.end());
+
+	for (size_t i = 0; i < m_ranges.size(); i++)
+	{
+		Range &range = m_ranges[i];
+		unsigned int next = (i + 1 < m_ranges.size()) ? m_ranges[i + 1].start : 0;
+
+		if (range.end == 0 || (next && range.end > next))
+			range.end = next ? next : range.start + 4;
+	}
+}
+
+const AddressIndex::Range *AddressIndex::find(unsigned int address) const
+{
+	auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), address, [](unsigned int address, const Range &range) {
+		return address < range.start;
+	});
+
+	if (it == m_ranges.begin())
+		return nullptr;
+
+	--it;
+
+	return (address < it->end) ? &*it : nullptr;
+}
+
+void AddressIndex::findAll(const std::vector<unsigned int> &addresses, std::vector<const Range*> *results) const
+{
+	std::vector<size_t> order(addresses.size());
+
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	std::sort(order.begin(), order.end(), [&addresses](size_t a, size_t b) {
+		return addresses[a] < addresses[b];
+	});
+
+	results->assign(addresses.size(), nullptr);
+
+	size_t r = 0;
+
+	for (size_t i : order)
+	{
+		unsigned int address = addresses[i];
+
+		while (r < m_ranges.size() && m_ranges[r].end <= address)
+			r++;
+
+		if (r == m_ranges.size())
+			break;
+
+		if (address >= m_ranges[r].start)
+			(*results)[i] = &m_ranges[r];
+	}
+}
+
+std::string AddressIndex::FunctionName(const Cpp::Function *function)
+{
+	if (function->typeOwner)
+		return function->typeOwner->name + "::" + function->name;
+
+	return function->name;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "cpp.h"
+
+#include <string>
+#include <vector>
+
+// Address ranges of every function, sorted by start address, for mapping
+// code addresses (profiler samples, crash dumps) back to functions.
+//
+// A function's end comes from the "Func End" record in the .line data,
+// which holds the offset of its last instruction. Instructions are assumed
+// to be 4 bytes, as on the MIPS and PowerPC targets this tool is used with.
+// Functions without line data extend to the start of the next function.
+class AddressIndex
+{
+public:
+	struct Range
+	{
+		unsigned int start;
+		unsigned int end; // exclusive
+		Cpp::Function *function;
+		Cpp::File *file;
+	};
+
+	AddressIndex(const std::vector<Cpp::File*> &files);
+
+	// Returns nullptr if no function contains address
+	const Range *find(unsigned int address) const;
+
+	// Looks up many addresses at once by sorting them and walking them
+	// alongside the ranges. results[i] is the range containing addresses[i],
+	// or nullptr.
+	void findAll(const std::vector<unsigned int> &addresses, std::vector<const Range*> *results) const;
+
+	inline const std::vector<Range> &getRanges() const
+	{
+		return m_ranges;
+	}
+
+	// Owner-qualified name, e.g. "xEnt::Update"
+	static std::string FunctionName(const Cpp::Function *function);
+
+private:
+	std::vector<Range> m_ranges;
+};
@@ -0,0 +1,533 @@
+#include "../../elf.h"
+#include "../../dwarf.h"
+#include "../../cpp.h"
+#include "../../convert.h"
+#include "../../output.h"
+#include "../dwarfgen/generator.h"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+namespace filesystem = std::experimental::filesystem;
+
+// Times every stage of a conversion on fixed generated inputs, so a change
+// that slows one of them down shows up on its own instead of being lost in
+// the total. Each phase is run --repeat times and the fastest run is kept,
+// which is the least affected by whatever else the machine is doing. The
+// gap to the slowest run is kept too, as a measure of how noisy the phase is.
+
+enum Phase
+{
+	PHASE_LOAD,    // reading the ELF file
+	PHASE_PARSE,   // reading .debug entries and .line
+	PHASE_CONVERT, // building the Cpp model
+	PHASE_RENDER,  // laying out and printing every file
+	PHASE_WRITE,   // writing the printed files to disk
+	PHASE_COUNT
+};
+
+const char *phaseNames[PHASE_COUNT] = { "load", "parse", "convert", "render", "write" };
+
+// Writing is at the mercy of the page cache and the disk, so it's timed this
+// many times per run and the fastest is used
+const int writeRepeat = 5;
+
+struct Input
+{
+	std::string name;
+	std::string path;
+	GeneratorOptions options;
+	bool generated;
+};
+
+struct Result
+{
+	double seconds[PHASE_COUNT]; // fastest
+	double slowest[PHASE_COUNT];
+	size_t entryCount;
+	uintmax_t fileSize;
+	size_t debugSize;
+	size_t outputSize;
+};
+
+// Sizes are picked so every input converts in a few seconds at most
+std::vector<Input> standardInputs()
+{
+	std::vector<Input> inputs;
+
+	Input small;
+	small.name = "small";
+	small.options.units = 100;
+	small.generated = true;
+	inputs.push_back(small);
+
+	Input medium;
+	medium.name = "medium";
+	medium.options.units = 1000;
+	medium.generated = true;
+	inputs.push_back(medium);
+
+	Input bigEndian = medium;
+	bigEndian.name = "medium-be";
+	bigEndian.options.bigEndian = true;
+	inputs.push_back(bigEndian);
+
+	// Few units with large structs, where layouts and member lists dominate
+	Input wide;
+	wide.name = "wide";
+	wide.options.units = 200;
+	wide.options.structs = 20;
+	wide.options.members = 40;
+	wide.generated = true;
+	inputs.push_back(wide);
+
+	return inputs;
+}
+
+double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Path of the file inside the output directory, as dwarf2cpp writes it
+std::string outputPath(Cpp::File *cpp)
+{
+	std::string filename = cpp->filename;
+	std::replace(filename.begin(), filename.end(), '\\', '/');
+
+	return filesystem::path(filename).relative_path().generic_string();
+}
+
+// Waits for data written or deleted earlier, by this or a previous run, to
+// reach the disk, so it isn't flushed in the middle of the timed writes
+void flushFileSystem()
+{
+#ifndef _WIN32
+	sync();
+#endif
+}
+
+// Runs every phase once, adding to the fastest and slowest times in result
+bool runOnce(const Input &input, const std::string &outDirectory, Result *result)
+{
+	double times[PHASE_COUNT];
+	double start = now();
+
+	ElfFile *elf = new ElfFile(input.path.c_str());
+
+	times[PHASE_LOAD] = now() - start;
+
+	if (elf->getError())
+	{
+		std::cerr << "Failed to parse " << input.path << " as an ELF file. Error Code: " << elf->getError() << std::endl;
+		delete elf;
+		return false;
+	}
+
+	start = now();
+	Dwarf *dwarf = loadDwarf(elf);
+	times[PHASE_PARSE] = now() - start;
+
+	if (!dwarf)
+	{
+		std::cerr << "Failed to parse the DWARF data in " << input.path << std::endl;
+		delete elf;
+		return false;
+	}
+
+	start = now();
+	bool processed = processDwarf(dwarf);
+	times[PHASE_CONVERT] = now() - start;
+
+	if (!processed)
+	{
+		std::cerr << "Failed to process the DWARF data in " << input.path << std::endl;
+		freeModel();
+		resetConverter();
+		delete dwarf;
+		delete elf;
+		return false;
+	}
+
+	// Rendered up front so the write phase only measures file I/O
+	std::vector<std::pair<std::string, std::string>> files;
+	Cpp::Emitter out;
+	size_t outputSize = 0;
+
+	start = now();
+
+	for (Cpp::File *cpp : cppFiles)
+	{
+		Cpp::ComputeLayouts(cpp);
+		Cpp::CacheNameFragments(cpp);
+
+		out.clear();
+		cpp->emit(out, false, false);
+
+		outputSize += out.buffer.size();
+		files.emplace_back(outputPath(cpp), out.buffer);
+	}
+
+	times[PHASE_RENDER] = now() - start;
+
+	std::error_code ec;
+	bool written = true;
+
+	times[PHASE_WRITE] = 1e30;
+
+	for (int w = 0; w < writeRepeat && written; w++)
+	{
+		filesystem::remove_all(outDirectory, ec);
+		flushFileSystem();
+
+		start = now();
+
+		OutputWriter writer(outDirectory, OutputWriter::MODE_DIRECTORY, 1);
+
+		for (auto &file : files)
+		{
+			const std::string *contents = &file.second;
+
+			writer.submit(file.first, [contents](Cpp::Emitter &out) {
+				out << *contents;
+			});
+		}
+
+		written = writer.finish();
+		times[PHASE_WRITE] = std::min(times[PHASE_WRITE], now() - start);
+	}
+
+	filesystem::remove_all(outDirectory, ec);
+
+	result->entryCount = dwarf->getEntryCount();
+	result->debugSize = dwarf->getSectionSize();
+	result->outputSize = outputSize;
+
+	for (int i = 0; i < PHASE_COUNT; i++)
+	{
+		result->seconds[i] = std::min(result->seconds[i], times[i]);
+		result->slowest[i] = std::max(result->slowest[i], times[i]);
+	}
+
+	freeModel();
+	resetConverter();
+	delete dwarf;
+	delete elf;
+
+	if (!written)
+	{
+		std::cerr << "Failed to write the output of " << input.path << " to " << outDirectory << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::string formatRate(double amount, double seconds)
+{
+	if (seconds <= 0.0)
+		return "-";
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.1f", amount / seconds);
+
+	return buffer;
+}
+
+void printResult(const Input &input, const Result &result)
+{
+	for (int i = 0; i < PHASE_COUNT; i++)
+	{
+		double seconds = result.seconds[i];
+		double spread = result.slowest[i] - seconds;
+		std::string entriesPerSecond = "-";
+		std::string megabytesPerSecond;
+
+		switch (i)
+		{
+		case PHASE_LOAD:
+			megabytesPerSecond = formatRate(result.fileSize / 1e6, seconds);
+			break;
+		case PHASE_PARSE:
+			entriesPerSecond = formatRate((double)result.entryCount, seconds);
+			megabytesPerSecond = formatRate(result.debugSize / 1e6, seconds);
+			break;
+		case PHASE_CONVERT:
+			entriesPerSecond = formatRate((double)result.entryCount, seconds);
+			megabytesPerSecond = formatRate(result.debugSize / 1e6, seconds);
+			break;
+		default:
+			megabytesPerSecond = formatRate(result.outputSize / 1e6, seconds);
+			break;
+		}
+
+		char line[160];
+		snprintf(line, sizeof(line), "%-12s %-8s %10.4f %10.4f %14s %10s", input.name.c_str(), phaseNames[i], seconds, spread,
+			entriesPerSecond.c_str(), megabytesPerSecond.c_str());
+
+		std::cout << line << std::endl;
+	}
+}
+
+struct BaselineEntry
+{
+	double seconds;
+	double spread;
+};
+
+// Lines of "<input> <phase> <seconds> <spread>". The spread is missing from
+// baselines saved before it was recorded, and taken as 0.
+bool loadBaseline(const char *path, std::map<std::string, BaselineEntry> *baseline)
+{
+	std::ifstream file(path);
+
+	if (!file)
+	{
+		std::cout << "Failed to open baseline " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		std::string input, phase;
+		BaselineEntry entry;
+
+		if (!(fields >> input >> phase >> entry.seconds))
+			continue;
+
+		if (!(fields >> entry.spread))
+			entry.spread = 0.0;
+
+		(*baseline)[input + " " + phase] = entry;
+	}
+
+	return true;
+}
+
+bool saveBaseline(const char *path, const std::vector<Input> &inputs, const std::vector<Result> &results)
+{
+	std::ofstream file(path);
+
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		for (int p = 0; p < PHASE_COUNT; p++)
+			file << inputs[i].name << " " << phaseNames[p] << " " << results[i].seconds[p] << " " << results[i].slowest[p] - results[i].seconds[p] << "\n";
+	}
+
+	file.close();
+
+	if (!file)
+	{
+		std::cout << "Failed to write baseline " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Runs every phase repeat times, adding to result
+bool runRepeats(const Input &input, const std::string &outDirectory, int repeat, Result *result)
+{
+	for (int r = 0; r < repeat; r++)
+	{
+		// Keep the converter's and writer's progress messages out of the table
+		std::streambuf *stdoutBuffer = std::cout.rdbuf(nullptr);
+		bool ok = runOnce(input, outDirectory, result);
+		std::cout.rdbuf(stdoutBuffer);
+
+		if (!ok)
+			return false;
+	}
+
+	return true;
+}
+
+// Phases that take a few milliseconds vary by that much from run to run with
+// any repeat count, so smaller differences never count
+const double minimumDifference = 0.005;
+
+// Whether the phase is slower than its baseline by more than threshold, and
+// by more than its noise: the spread between the baseline's fastest and
+// slowest repeats. This run's spread doesn't count, or a change that made a
+// phase noisier as well as slower would excuse itself.
+bool isRegression(const Result &result, int phase, const BaselineEntry &base, double threshold, double *noise)
+{
+	double seconds = result.seconds[phase];
+
+	*noise = std::max(minimumDifference, base.spread);
+
+	return seconds > base.seconds * (1.0 + threshold) && seconds - base.seconds > *noise;
+}
+
+int main(int argc, char **argv)
+{
+	std::string inputDirectory = "bench-inputs";
+	std::string outDirectory;
+	const char *baselinePath = nullptr;
+	const char *saveBaselinePath = nullptr;
+	double threshold = 0.10;
+	int repeat = 3;
+	std::vector<Input> inputs;
+	bool standard = true;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--inputs" && i + 1 < argc)
+			inputDirectory = argv[++i];
+		else if (arg == "--output" && i + 1 < argc)
+			outDirectory = argv[++i];
+		else if (arg == "--repeat" && i + 1 < argc)
+			repeat = std::max(1, atoi(argv[++i]));
+		else if (arg == "--baseline" && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (arg == "--save-baseline" && i + 1 < argc)
+			saveBaselinePath = argv[++i];
+		else if (arg == "--threshold" && i + 1 < argc)
+			threshold = std::max(0.0, atof(argv[++i]));
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			std::cout << "Usage: bench [--inputs <directory>] [--output <directory>] [--repeat N] [--baseline <file>] [--threshold F] [--save-baseline <file>] [ELF file...]" << std::endl;
+			return 1;
+		}
+		else
+		{
+			// Files given on the command line replace the generated inputs
+			Input input;
+			input.name = filesystem::path(arg).stem().string();
+			input.path = arg;
+			input.generated = false;
+			inputs.push_back(input);
+			standard = false;
+		}
+	}
+
+	if (standard)
+		inputs = standardInputs();
+
+	if (outDirectory.empty())
+		outDirectory = inputDirectory + "/output";
+
+	for (Input &input : inputs)
+	{
+		if (!input.generated)
+			continue;
+
+		input.path = inputDirectory + "/" + input.name + ".elf";
+
+		if (filesystem::exists(input.path))
+			continue;
+
+		std::cout << "Generating " << input.path << "..." << std::endl;
+
+		filesystem::create_directories(inputDirectory);
+
+		size_t entryCount;
+
+		if (!generate(input.options, input.path.c_str(), &entryCount))
+			return 1;
+	}
+
+	std::map<std::string, BaselineEntry> baseline;
+
+	if (baselinePath && !loadBaseline(baselinePath, &baseline))
+		return 1;
+
+	char header[160];
+	snprintf(header, sizeof(header), "%-12s %-8s %10s %10s %14s %10s", "input", "phase", "seconds", "spread", "entries/s", "MB/s");
+	std::cout << header << std::endl;
+
+	std::vector<Result> results;
+
+	for (const Input &input : inputs)
+	{
+		Result result;
+
+		for (int i = 0; i < PHASE_COUNT; i++)
+		{
+			result.seconds[i] = 1e30;
+			result.slowest[i] = 0.0;
+		}
+
+		std::error_code ec;
+		result.fileSize = filesystem::file_size(input.path, ec);
+
+		if (!runRepeats(input, outDirectory, repeat, &result))
+			return 1;
+
+		printResult(input, result);
+		results.push_back(result);
+	}
+
+	if (saveBaselinePath && !saveBaseline(saveBaselinePath, inputs, results))
+		return 1;
+
+	if (!baselinePath)
+		return 0;
+
+	int regressions = 0;
+
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		for (int p = 0; p < PHASE_COUNT; p++)
+		{
+			auto it = baseline.find(inputs[i].name + " " + phaseNames[p]);
+
+			if (it == baseline.end())
+			{
+				std::cout << "No baseline for " << inputs[i].name << " " << phaseNames[p] << std::endl;
+				continue;
+			}
+
+			double seconds = results[i].seconds[p];
+			double spread = results[i].slowest[p] - seconds;
+			double base = it->second.seconds;
+			double noise;
+
+			if (spread > std::max(minimumDifference, it->second.spread))
+			{
+				char line[160];
+				snprintf(line, sizeof(line), "WARNING: %s %s varied by %.4f s, baseline %.4f s", inputs[i].name.c_str(),
+					phaseNames[p], spread, it->second.spread);
+
+				std::cout << line << std::endl;
+			}
+
+			if (isRegression(results[i], p, it->second, threshold, &noise))
+			{
+				char line[160];
+				snprintf(line, sizeof(line), "REGRESSION: %s %s took %.4f s, baseline %.4f s (+%.0f%%, noise %.4f s)", inputs[i].name.c_str(),
+					phaseNames[p], seconds, base, (seconds / base - 1.0) * 100.0, noise);
+
+				std::cout << line << std::endl;
+				regressions++;
+			}
+		}
+	}
+
+	if (regressions)
+	{
+		std::cout << regressions << " phases regressed by more than " << threshold * 100.0 << "%" << std::endl;
+		return 1;
+	}
+
+	std::cout << "No phase regressed by more than " << threshold * 100.0 << "%" << std::endl;
+	return 0;
+}
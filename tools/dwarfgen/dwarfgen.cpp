@@ -0,0 +1,92 @@
+#include "generator.h"
+
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+int main(int argc, char **argv)
+{
+	GeneratorOptions options;
+	const char *output = nullptr;
+
+	struct
+	{
+		const char *name;
+		int *value;
+	}
+	counts[] =
+	{
+		{ "--units", &options.units },
+		{ "--shared-structs", &options.sharedStructs },
+		{ "--structs", &options.structs },
+		{ "--members", &options.members },
+		{ "--enums", &options.enums },
+		{ "--arrays", &options.arrays },
+		{ "--subroutine-types", &options.subroutineTypes },
+		{ "--globals", &options.globals },
+		{ "--functions", &options.functions },
+		{ "--locals", &options.locals },
+		{ "--lines", &options.lines }
+	};
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool isCount = false;
+
+		for (auto &count : counts)
+		{
+			if (arg == count.name && i + 1 < argc)
+			{
+				*count.value = std::max(0, atoi(argv[++i]));
+				isCount = true;
+				break;
+			}
+		}
+
+		if (isCount)
+			continue;
+
+		if (arg == "--big-endian")
+			options.bigEndian = true;
+		else if (arg == "--seed" && i + 1 < argc)
+			options.seed = strtoull(argv[++i], nullptr, 0);
+		else if (arg.compare(0, 2, "--") == 0 || output)
+		{
+			output = nullptr;
+			break;
+		}
+		else
+			output = argv[i];
+	}
+
+	if (!output)
+	{
+		std::cout << "Usage: dwarfgen [options] <output ELF file>" << std::endl;
+		std::cout << "Options (counts are per compile unit unless noted):" << std::endl;
+		std::cout << "  --units N             compile units (100)" << std::endl;
+		std::cout << "  --shared-structs N    structs repeated in every unit, as if from a common header (10)" << std::endl;
+		std::cout << "  --structs N           structs of the unit's own (10)" << std::endl;
+		std::cout << "  --members N           average members per struct (8)" << std::endl;
+		std::cout << "  --enums N             enums, for both the shared and the unit's own types (2)" << std::endl;
+		std::cout << "  --arrays N            array types, for both the shared and the unit's own types (4)" << std::endl;
+		std::cout << "  --subroutine-types N  function pointer types, for both the shared and the unit's own types (2)" << std::endl;
+		std::cout << "  --globals N           global and static variables (4)" << std::endl;
+		std::cout << "  --functions N         functions (20)" << std::endl;
+		std::cout << "  --locals N            locals per function (4)" << std::endl;
+		std::cout << "  --lines N             .line records per function, besides the end record (8)" << std::endl;
+		std::cout << "  --big-endian          write a big-endian (PowerPC) file instead of a little-endian (MIPS) one" << std::endl;
+		std::cout << "  --seed N              seed for the generated contents (1)";
+		return 1;
+	}
+
+	size_t entryCount;
+
+	if (!generate(options, output, &entryCount))
+		return 1;
+
+	std::cout << "Wrote " << entryCount << " entries in " << options.units << " compile units to " << output << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,791 @@
+#include "generator.h"
+#include "../../elf.h"
+#include "../../dwarf.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+#define EM_PPC 20
+
+#define SHT_NULL     0
+#define SHT_PROGBITS 1
+#define SHT_STRTAB   3
+
+namespace
+{
+// splitmix64, so files don't depend on the standard library's distributions
+class Random
+{
+public:
+	Random(uint64_t seed)
+	{
+		m_state = seed;
+	}
+
+	uint32_t next(uint32_t bound)
+	{
+		uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		z ^= z >> 31;
+
+		return bound ? (uint32_t)(z % bound) : 0;
+	}
+
+	bool chance(int percent)
+	{
+		return (int)next(100) < percent;
+	}
+
+private:
+	uint64_t m_state;
+};
+
+class ByteBuffer
+{
+public:
+	std::vector<char> data;
+
+	ByteBuffer(bool bigEndian)
+	{
+		m_bigEndian = bigEndian;
+	}
+
+	inline bool isBigEndian() const
+	{
+		return m_bigEndian;
+	}
+
+	void put8(uint8_t x)
+	{
+		data.push_back((char)x);
+	}
+
+	void put16(uint16_t x)
+	{
+		if (m_bigEndian)
+			x = swap2(x);
+
+		data.insert(data.end(), (char*)&x, (char*)&x + sizeof(x));
+	}
+
+	void put32(uint32_t x)
+	{
+		if (m_bigEndian)
+			x = swap4(x);
+
+		data.insert(data.end(), (char*)&x, (char*)&x + sizeof(x));
+	}
+
+	void putString(const std::string &s)
+	{
+		data.insert(data.end(), s.c_str(), s.c_str() + s.size() + 1);
+	}
+
+	void patch32(size_t position, uint32_t x)
+	{
+		if (m_bigEndian)
+			x = swap4(x);
+
+		memcpy(&data[position], &x, sizeof(x));
+	}
+
+private:
+	bool m_bigEndian;
+};
+
+// Appends .debug entries. Every entry gets a sibling reference, and each
+// list of children ends with a null entry, like the compilers that produce
+// DWARF 1 do.
+class DebugWriter : public ByteBuffer
+{
+public:
+	DebugWriter(bool bigEndian, Elf32_Off base) : ByteBuffer(bigEndian)
+	{
+		m_base = base;
+		m_entryCount = 0;
+	}
+
+	// Offset in the .debug section of the next entry
+	inline Elf32_Off offset() const
+	{
+		return m_base + (Elf32_Off)data.size();
+	}
+
+	inline size_t getEntryCount() const
+	{
+		return m_entryCount;
+	}
+
+	// Writes the entry's header. Attributes follow, then either end() or
+	// beginChildren() ... endChildren().
+	void begin(Elf32_Half tag)
+	{
+		Open entry;
+		entry.start = data.size();
+
+		put32(0);
+		put16(tag);
+		put16(DW_AT_sibling);
+
+		entry.sibling = data.size();
+		put32(0);
+
+		m_open.push_back(entry);
+		m_entryCount++;
+	}
+
+	void end()
+	{
+		patch32(m_open.back().start, (uint32_t)(data.size() - m_open.back().start));
+		patch32(m_open.back().sibling, offset());
+		m_open.pop_back();
+	}
+
+	void beginChildren()
+	{
+		patch32(m_open.back().start, (uint32_t)(data.size() - m_open.back().start));
+	}
+
+	void endChildren()
+	{
+		putNull();
+
+		patch32(m_open.back().sibling, offset());
+		m_open.pop_back();
+	}
+
+	void putNull()
+	{
+		put32(4);
+		m_entryCount++;
+	}
+
+	void attrString(Elf32_Half name, const std::string &value)
+	{
+		put16(name);
+		putString(value);
+	}
+
+	void attrHalf(Elf32_Half name, Elf32_Half value)
+	{
+		put16(name);
+		put16(value);
+	}
+
+	void attrWord(Elf32_Half name, Elf32_Word value)
+	{
+		put16(name);
+		put32(value);
+	}
+
+	void attrBlock2(Elf32_Half name, const ByteBuffer &block)
+	{
+		put16(name);
+		put16((uint16_t)block.data.size());
+		data.insert(data.end(), block.data.begin(), block.data.end());
+	}
+
+	void attrBlock4(Elf32_Half name, const ByteBuffer &block)
+	{
+		put16(name);
+		put32((uint32_t)block.data.size());
+		data.insert(data.end(), block.data.begin(), block.data.end());
+	}
+
+	void attrLocation(Elf32_Half op, Elf32_Word value)
+	{
+		ByteBuffer block(isBigEndian());
+		block.put8((uint8_t)op);
+		block.put32(value);
+
+		attrBlock2(DW_AT_location, block);
+	}
+
+private:
+	struct Open
+	{
+		size_t start;
+		size_t sibling;
+	};
+
+	Elf32_Off m_base;
+	size_t m_entryCount;
+	std::vector<Open> m_open;
+};
+
+struct TypeRef
+{
+	bool fundamental;
+	bool pointer;
+	Elf32_Half fundType;
+	Elf32_Off ref;
+	int size;
+	int alignment;
+
+	static TypeRef Fundamental(Elf32_Half fundType, int size)
+	{
+		return { true, false, fundType, 0, size, size };
+	}
+
+	static TypeRef User(Elf32_Off ref, int size, int alignment)
+	{
+		return { false, false, 0, ref, size, alignment };
+	}
+
+	TypeRef pointerTo() const
+	{
+		TypeRef p = *this;
+		p.pointer = true;
+		p.size = 4;
+		p.alignment = 4;
+		return p;
+	}
+};
+
+// Types a unit's entries can refer to
+struct Types
+{
+	std::vector<TypeRef> enums;
+	std::vector<TypeRef> arrays;
+	std::vector<TypeRef> structs;
+	std::vector<std::string> structNames;
+	std::vector<TypeRef> subroutines;
+};
+
+const struct
+{
+	Elf32_Half type;
+	int size;
+}
+fundamentalTypes[] =
+{
+	{ DW_FT_char, 1 },
+	{ DW_FT_unsigned_char, 1 },
+	{ DW_FT_short, 2 },
+	{ DW_FT_unsigned_short, 2 },
+	{ DW_FT_integer, 4 },
+	{ DW_FT_unsigned_integer, 4 },
+	{ DW_FT_long, 4 },
+	{ DW_FT_float, 4 },
+	{ DW_FT_dbl_prec_float, 8 },
+	{ DW_FT_boolean, 1 },
+	{ DW_FT_long_long, 8 }
+};
+
+TypeRef randomFundamentalType(Random &random)
+{
+	auto &ft = fundamentalTypes[random.next(sizeof(fundamentalTypes) / sizeof(fundamentalTypes[0]))];
+	return TypeRef::Fundamental(ft.type, ft.size);
+}
+
+template<class T>
+const T &pick(Random &random, const std::vector<T> &v)
+{
+	return v[random.next((uint32_t)v.size())];
+}
+
+// Any type a member, variable or parameter can have. Structs by value are
+// only picked when allowed, so callers can keep layouts acyclic.
+TypeRef randomType(Random &random, const Types &types, bool structsByValue)
+{
+	uint32_t roll = random.next(100);
+
+	if (roll < 40)
+		return randomFundamentalType(random);
+
+	if (roll < 60 && !types.structs.empty())
+		return pick(random, types.structs).pointerTo();
+
+	if (roll < 70 && structsByValue && !types.structs.empty())
+		return pick(random, types.structs);
+
+	if (roll < 78 && !types.enums.empty())
+		return pick(random, types.enums);
+
+	if (roll < 88 && !types.arrays.empty())
+		return pick(random, types.arrays);
+
+	if (roll < 94 && !types.subroutines.empty())
+		return pick(random, types.subroutines);
+
+	return randomFundamentalType(random).pointerTo();
+}
+
+void writeType(DebugWriter &w, const TypeRef &type)
+{
+	if (!type.pointer)
+	{
+		if (type.fundamental)
+			w.attrHalf(DW_AT_fund_type, type.fundType);
+		else
+			w.attrWord(DW_AT_user_def_type, type.ref);
+
+		return;
+	}
+
+	ByteBuffer block(w.isBigEndian());
+	block.put8(DW_MOD_pointer_to);
+
+	if (type.fundamental)
+	{
+		block.put16(type.fundType);
+		w.attrBlock2(DW_AT_mod_fund_type, block);
+	}
+	else
+	{
+		block.put32(type.ref);
+		w.attrBlock2(DW_AT_mod_u_d_type, block);
+	}
+}
+
+int alignUp(int x, int alignment)
+{
+	return (x + alignment - 1) / alignment * alignment;
+}
+
+TypeRef writeArrayType(DebugWriter &w, Random &random, const TypeRef &element)
+{
+	Elf32_Off offset = w.offset();
+	int count = 1;
+
+	ByteBuffer subscripts(w.isBigEndian());
+	int dimensions = random.chance(25) ? 2 : 1;
+
+	for (int i = 0; i < dimensions; i++)
+	{
+		int size = 1 + random.next(i ? 4 : 16);
+		count *= size;
+
+		subscripts.put8(DW_FMT_FT_C_C);
+		subscripts.put16(DW_FT_long);
+		subscripts.put32(0);
+		subscripts.put32(size - 1);
+	}
+
+	subscripts.put8(DW_FMT_ET);
+
+	if (element.fundamental)
+	{
+		subscripts.put16(DW_AT_fund_type);
+		subscripts.put16(element.fundType);
+	}
+	else
+	{
+		subscripts.put16(DW_AT_user_def_type);
+		subscripts.put32(element.ref);
+	}
+
+	w.begin(DW_TAG_array_type);
+	w.attrHalf(DW_AT_ordering, DW_ORD_row_major);
+	w.attrBlock2(DW_AT_subscr_data, subscripts);
+	w.end();
+
+	return TypeRef::User(offset, element.size * count, element.alignment);
+}
+
+struct Member
+{
+	std::string name;
+	TypeRef type;
+	int offset;
+	int bitOffset;
+	int bitSize; // 0 if not a bitfield
+};
+
+void writeStruct(DebugWriter &w, Random &random, const GeneratorOptions &options, const std::string &name, Types *types)
+{
+	Elf32_Off offset = w.offset();
+	bool isUnion = random.chance(10);
+
+	std::vector<Member> members;
+	TypeRef base = {};
+	bool hasBase = !isUnion && !types->structs.empty() && random.chance(20);
+
+	int size = 0;
+	int alignment = 1;
+
+	if (hasBase)
+	{
+		base = pick(random, types->structs);
+		size = base.size;
+		alignment = base.alignment;
+	}
+
+	int memberCount = std::max(1, options.members / 2 + (int)random.next(options.members + 1));
+
+	for (int i = 0; i < memberCount; i++)
+	{
+		Member m;
+		m.name = "m" + std::to_string(i);
+		m.bitOffset = 0;
+		m.bitSize = 0;
+
+		// Self pointers, as in linked lists
+		if (random.chance(5))
+			m.type = TypeRef::User(offset, 0, 1).pointerTo();
+		else
+			m.type = randomType(random, *types, true);
+
+		int count = 1;
+
+		if (!isUnion && random.chance(5))
+		{
+			// A few bitfields sharing an unsigned int
+			m.type = TypeRef::Fundamental(DW_FT_unsigned_integer, 4);
+			count = 2 + random.next(3);
+		}
+
+		int memberOffset = isUnion ? 0 : alignUp(size, m.type.alignment);
+
+		for (int b = 0; b < count; b++)
+		{
+			Member field = m;
+			field.offset = memberOffset;
+
+			if (count > 1)
+			{
+				field.name += "_" + std::to_string(b);
+				field.bitSize = 32 / count;
+				field.bitOffset = b * field.bitSize;
+			}
+
+			members.push_back(field);
+		}
+
+		size = isUnion ? std::max(size, m.type.size) : memberOffset + m.type.size;
+		alignment = std::max(alignment, m.type.alignment);
+	}
+
+	size = std::max(1, alignUp(size, alignment));
+
+	w.begin(isUnion ? DW_TAG_union_type : DW_TAG_structure_type);
+	w.attrString(DW_AT_name, name);
+	w.attrWord(DW_AT_byte_size, size);
+	w.beginChildren();
+
+	if (hasBase)
+	{
+		w.begin(DW_TAG_inheritance);
+		writeType(w, base);
+		w.attrLocation(DW_OP_CONST, 0);
+		w.end();
+	}
+
+	for (Member &m : members)
+	{
+		w.begin(DW_TAG_member);
+		w.attrString(DW_AT_name, m.name);
+		writeType(w, m.type);
+		w.attrLocation(DW_OP_CONST, m.offset);
+
+		if (m.bitSize)
+		{
+			w.attrHalf(DW_AT_bit_offset, m.bitOffset);
+			w.attrWord(DW_AT_bit_size, m.bitSize);
+		}
+
+		w.end();
+	}
+
+	w.endChildren();
+
+	TypeRef type = TypeRef::User(offset, size, alignment);
+
+	types->structs.push_back(type);
+	types->structNames.push_back(name);
+
+	// Arrays of structs, for later members to use
+	if (random.chance(30))
+		types->arrays.push_back(writeArrayType(w, random, type));
+}
+
+// Writes enums, arrays, structs and subroutine types. prefix keeps the
+// names of each unit's own types apart.
+void writeTypes(DebugWriter &w, Random &random, const GeneratorOptions &options, const std::string &prefix, int structCount, Types *types)
+{
+	for (int i = 0; i < options.enums; i++)
+	{
+		Elf32_Off offset = w.offset();
+
+		ByteBuffer elements(w.isBigEndian());
+		int count = 2 + random.next(8);
+
+		for (int e = 0; e < count; e++)
+		{
+			elements.put32(e);
+			elements.putString(prefix + "Enum" + std::to_string(i) + "_Value" + std::to_string(e));
+		}
+
+		w.begin(DW_TAG_enumeration_type);
+		w.attrString(DW_AT_name, prefix + "Enum" + std::to_string(i));
+		w.attrWord(DW_AT_byte_size, 4);
+		w.attrBlock4(DW_AT_element_list, elements);
+		w.end();
+
+		types->enums.push_back(TypeRef::User(offset, 4, 4));
+	}
+
+	for (int i = 0; i < options.arrays; i++)
+		types->arrays.push_back(writeArrayType(w, random, randomFundamentalType(random)));
+
+	for (int i = 0; i < structCount; i++)
+		writeStruct(w, random, options, prefix + "Struct" + std::to_string(i), types);
+
+	for (int i = 0; i < options.subroutineTypes; i++)
+	{
+		Elf32_Off offset = w.offset();
+
+		w.begin(DW_TAG_subroutine_type);
+		writeType(w, randomFundamentalType(random));
+		w.beginChildren();
+
+		int count = 1 + random.next(3);
+
+		for (int p = 0; p < count; p++)
+		{
+			w.begin(DW_TAG_formal_parameter);
+			w.attrString(DW_AT_name, "p" + std::to_string(p));
+			writeType(w, randomType(random, *types, false));
+			w.end();
+		}
+
+		w.endChildren();
+
+		types->subroutines.push_back(TypeRef::User(offset, 4, 4));
+	}
+}
+
+void writeFunction(DebugWriter &w, ByteBuffer &lines, Random &random, const GeneratorOptions &options, const Types &types,
+	const std::string &name, Elf32_Addr *address)
+{
+	Elf32_Addr start = *address;
+	int size = 4 * (options.lines + 2 + (int)random.next(32));
+	*address += size;
+
+	int owner = (!types.structs.empty() && random.chance(25)) ? (int)random.next((uint32_t)types.structs.size()) : -1;
+	std::string mangledName = name + "__";
+
+	if (owner != -1)
+		mangledName += std::to_string(types.structNames[owner].size()) + types.structNames[owner];
+
+	mangledName += "Fv";
+
+	w.begin(random.chance(80) ? DW_TAG_global_subroutine : DW_TAG_subroutine);
+	w.attrString(DW_AT_name, name);
+	w.attrString(DW_AT_mangled_name, mangledName);
+	w.attrWord(DW_AT_low_pc, start);
+	w.attrWord(DW_AT_high_pc, start + size);
+	writeType(w, randomType(random, types, false));
+	w.beginChildren();
+
+	if (owner != -1)
+	{
+		w.begin(DW_TAG_formal_parameter);
+		w.attrString(DW_AT_name, "this");
+		writeType(w, types.structs[owner].pointerTo());
+		w.end();
+	}
+
+	int parameterCount = random.next(4);
+
+	for (int i = 0; i < parameterCount; i++)
+	{
+		w.begin(DW_TAG_formal_parameter);
+		w.attrString(DW_AT_name, "arg" + std::to_string(i));
+		writeType(w, randomType(random, types, true));
+		w.end();
+	}
+
+	w.begin(DW_TAG_lexical_block);
+	w.attrWord(DW_AT_low_pc, start);
+	w.attrWord(DW_AT_high_pc, start + size);
+	w.beginChildren();
+
+	for (int i = 0; i < options.locals; i++)
+	{
+		w.begin(DW_TAG_local_variable);
+		w.attrString(DW_AT_name, "local" + std::to_string(i));
+		writeType(w, randomType(random, types, true));
+		w.end();
+	}
+
+	w.endChildren();
+	w.endChildren();
+
+	// One .line chunk per function: line, column (-1 for none) and offset
+	// records, then a "Func End" record with the offset of the last
+	// instruction
+	lines.put32(8 + (options.lines + 1) * 10);
+	lines.put32(start);
+
+	int line = 10 + random.next(1000);
+
+	for (int i = 0; i < options.lines; i++)
+	{
+		lines.put32(line);
+		lines.put16(0xffff);
+		lines.put32(i * (size - 4) / std::max(1, options.lines));
+
+		line += 1 + random.next(4);
+	}
+
+	lines.put32(0);
+	lines.put16(0xffff);
+	lines.put32(size - 4);
+}
+
+void writeUnit(DebugWriter &w, ByteBuffer &lines, const GeneratorOptions &options, int unit, Elf32_Addr *codeAddress, Elf32_Addr *dataAddress)
+{
+	w.begin(DW_TAG_compile_unit);
+	w.attrString(DW_AT_name, "C:\\gen\\dir" + std::to_string(unit % 16) + "\\unit" + std::to_string(unit) + ".cpp");
+	w.attrWord(DW_AT_language, DW_LANG_C_PLUS_PLUS);
+	w.beginChildren();
+
+	Types types;
+
+	// The shared types come out the same in every unit, like types from a
+	// header that every unit includes
+	Random shared(options.seed);
+	writeTypes(w, shared, options, "", options.sharedStructs, &types);
+
+	Random random(options.seed ^ (0x9e3779b97f4a7c15ull * (uint64_t)(unit + 1)));
+	std::string prefix = "Unit" + std::to_string(unit);
+	writeTypes(w, random, options, prefix, options.structs, &types);
+
+	for (int i = 0; i < options.globals; i++)
+	{
+		TypeRef type = randomType(random, types, true);
+
+		w.begin(random.chance(75) ? DW_TAG_global_variable : DW_TAG_local_variable);
+		w.attrString(DW_AT_name, "g" + prefix + "_" + std::to_string(i));
+		writeType(w, type);
+		w.attrLocation(DW_OP_ADDR, *dataAddress);
+		w.end();
+
+		*dataAddress += alignUp(std::max(type.size, 4), 4);
+	}
+
+	for (int i = 0; i < options.functions; i++)
+		writeFunction(w, lines, random, options, types, "func" + std::to_string(unit) + "_" + std::to_string(i), codeAddress);
+
+	w.endChildren();
+}
+
+void writeSectionHeader(ByteBuffer &out, Elf32_Word name, Elf32_Word type, Elf32_Off offset, Elf32_Word size, Elf32_Word alignment)
+{
+	out.put32(name);
+	out.put32(type);
+	out.put32(0);
+	out.put32(0);
+	out.put32(offset);
+	out.put32(size);
+	out.put32(0);
+	out.put32(0);
+	out.put32(alignment);
+	out.put32(0);
+}
+
+}
+
+// Streams .debug to the file a unit at a time, so the size of the output
+// isn't limited by memory. .line is much smaller and is kept until the end.
+bool generate(const GeneratorOptions &options, const char *path, size_t *outEntryCount)
+{
+	std::ofstream file(path, std::ios::binary);
+
+	if (!file)
+	{
+		std::cout << "ERROR: Failed to open " << path << std::endl;
+		return false;
+	}
+
+	const Elf32_Off debugOffset = sizeof(Elf32_Ehdr);
+	Elf32_Off debugSize = 0;
+	size_t entryCount = 0;
+
+	ByteBuffer header(options.bigEndian);
+	header.data.resize(debugOffset);
+	file.write(header.data.data(), header.data.size());
+
+	ByteBuffer lines(options.bigEndian);
+	Elf32_Addr codeAddress = 0x80003100;
+	Elf32_Addr dataAddress = 0x80400000;
+
+	for (int unit = 0; unit < options.units; unit++)
+	{
+		DebugWriter w(options.bigEndian, debugSize);
+
+		writeUnit(w, lines, options, unit, &codeAddress, &dataAddress);
+
+		if (unit == options.units - 1)
+			w.putNull();
+
+		file.write(w.data.data(), w.data.size());
+		debugSize += (Elf32_Off)w.data.size();
+		entryCount += w.getEntryCount();
+	}
+
+	Elf32_Off lineOffset = debugOffset + debugSize;
+	Elf32_Off stringsOffset = lineOffset + (Elf32_Off)lines.data.size();
+
+	ByteBuffer strings(options.bigEndian);
+	strings.put8(0);
+	strings.putString(".debug");
+	strings.putString(".line");
+	strings.putString(".shstrtab");
+
+	Elf32_Off sectionHeadersOffset = alignUp(stringsOffset + (Elf32_Off)strings.data.size(), 4);
+	strings.data.resize(sectionHeadersOffset - stringsOffset);
+
+	ByteBuffer sections(options.bigEndian);
+	writeSectionHeader(sections, 0, SHT_NULL, 0, 0, 0);
+	writeSectionHeader(sections, 1, SHT_DWARF1, debugOffset, debugSize, 1);
+	writeSectionHeader(sections, 8, SHT_PROGBITS, lineOffset, (Elf32_Word)lines.data.size(), 1);
+	writeSectionHeader(sections, 14, SHT_STRTAB, stringsOffset, (Elf32_Word)strings.data.size(), 1);
+
+	file.write(lines.data.data(), lines.data.size());
+	file.write(strings.data.data(), strings.data.size());
+	file.write(sections.data.data(), sections.data.size());
+
+	header.data.clear();
+	header.put8(0x7f);
+	header.put8('E');
+	header.put8('L');
+	header.put8('F');
+	header.put8(ELFCLASS32);
+	header.put8(options.bigEndian ? ELFDATA2MSB : ELFDATA2LSB);
+	header.put8(EV_CURRENT);
+	header.data.resize(EI_NIDENT);
+	header.put16(ET_EXEC);
+	header.put16(options.bigEndian ? EM_PPC : EM_MIPS);
+	header.put32(EV_CURRENT);
+	header.put32(0);
+	header.put32(0);
+	header.put32(sectionHeadersOffset);
+	header.put32(0);
+	header.put16(sizeof(Elf32_Ehdr));
+	header.put16(0);
+	header.put16(0);
+	header.put16(sizeof(Elf32_Shdr));
+	header.put16(4);
+	header.put16(3);
+
+	file.seekp(0);
+	file.write(header.data.data(), header.data.size());
+	file.close();
+
+	if (!file)
+	{
+		std::cout << "ERROR: Failed to write " << path << std::endl;
+		return false;
+	}
+
+	*outEntryCount = entryCount;
+
+	return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Writes ELF files with made-up DWARF 1 debug information, for testing
+// dwarf2cpp at scale without a game executable. The same options and seed
+// always give the same file, on any platform.
+
+// Counts are per compile unit unless noted
+struct GeneratorOptions
+{
+	int units = 100;
+	int sharedStructs = 10;
+	int structs = 10;
+	int members = 8;
+	int enums = 2;
+	int arrays = 4;
+	int subroutineTypes = 2;
+	int globals = 4;
+	int functions = 20;
+	int locals = 4;
+	int lines = 8;
+	bool bigEndian = false;
+	uint64_t seed = 1;
+};
+
+// Streams the file to path. Returns false if it couldn't be written.
+bool generate(const GeneratorOptions &options, const char *path, size_t *outEntryCount);
@@ -0,0 +1,319 @@
+#include "../../elf.h"
+#include "../../dwarf.h"
+#include "../../cpp.h"
+#include "../../convert.h"
+#include "../../alloc.h"
+#include "../dwarfgen/generator.h"
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+namespace filesystem = std::experimental::filesystem;
+
+// Times single hot functions of the decoder, converter and renderer in
+// isolation, so a change to one of them can be judged without the noise of
+// a whole conversion. Every fixture runs its function over samples taken
+// from a real (or generated) file for at least --min-time seconds, and
+// reports the time and number of heap allocations per call.
+
+// Results are added here so the calls being timed can't be optimized away
+volatile uintptr_t sink;
+
+double minTime = 0.25;
+std::string nameFilter;
+
+double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Calls op(i) for every sample i, over and over until minTime has passed.
+// The first pass is a warm-up and isn't counted.
+template<class Op>
+void run(const std::string &name, size_t sampleCount, Op op)
+{
+	if (!nameFilter.empty() && name.find(nameFilter) == std::string::npos)
+		return;
+
+	char line[160];
+
+	if (sampleCount == 0)
+	{
+		snprintf(line, sizeof(line), "%-36s %10s", name.c_str(), "no samples");
+		std::cout << line << std::endl;
+		return;
+	}
+
+	for (size_t i = 0; i < sampleCount; i++)
+		op(i);
+
+	size_t calls = 0;
+	uint64_t allocations = AllocationTracker::GetTotals().count;
+	double start = now();
+	double elapsed = 0.0;
+
+	do
+	{
+		for (size_t i = 0; i < sampleCount; i++)
+			op(i);
+
+		calls += sampleCount;
+		elapsed = now() - start;
+	}
+	while (elapsed < minTime);
+
+	allocations = AllocationTracker::GetTotals().count - allocations;
+
+	snprintf(line, sizeof(line), "%-36s %10zu %12.1f %12.2f", name.c_str(), sampleCount, elapsed * 1e9 / calls,
+		(double)allocations / calls);
+
+	std::cout << line << std::endl;
+}
+
+// Shuffled so lookups don't walk memory in order, which real ones don't
+template<class T>
+void shuffle(std::vector<T> &v)
+{
+	std::mt19937 random(1);
+	std::shuffle(v.begin(), v.end(), random);
+}
+
+const char *formName(Elf32_Half form)
+{
+	switch (form)
+	{
+	case DW_FORM_ADDR: return "addr";
+	case DW_FORM_REF: return "ref";
+	case DW_FORM_BLOCK2: return "block2";
+	case DW_FORM_BLOCK4: return "block4";
+	case DW_FORM_DATA2: return "data2";
+	case DW_FORM_DATA4: return "data4";
+	case DW_FORM_DATA8: return "data8";
+	case DW_FORM_STRING: return "string";
+	}
+
+	return "";
+}
+
+void benchmarkDecoder(Dwarf *dwarf)
+{
+	// Attributes are read back into a scratch entry whose list is emptied
+	// before every call, so only the decoding is measured
+	Dwarf::Entry scratch;
+	scratch.dwarf = dwarf;
+	scratch.index = 0;
+
+	for (Elf32_Half form = DW_FORM_ADDR; form <= DW_FORM_STRING; form++)
+	{
+		std::vector<Elf32_Off> offsets;
+
+		for (Dwarf::Entry &entry : dwarf->entries)
+		{
+			for (Dwarf::Attribute &attr : entry.attributes)
+			{
+				if (attr.getForm() == form)
+					offsets.push_back(attr.offset);
+			}
+		}
+
+		shuffle(offsets);
+
+		run(std::string("Dwarf::readAttribute ") + formName(form), offsets.size(), [&](size_t i) {
+			scratch.attributes.clear();
+			sink += dwarf->readAttribute(offsets[i], &scratch);
+		});
+	}
+
+	run("Entry::getSibling", dwarf->entries.size(), [&](size_t i) {
+		sink += (uintptr_t)dwarf->entries[i].getSibling();
+	});
+
+	std::vector<Elf32_Off> references;
+
+	for (Dwarf::Entry &entry : dwarf->entries)
+		references.push_back(entry.offset);
+
+	shuffle(references);
+
+	run("Dwarf::getEntryFromReference", references.size(), [&](size_t i) {
+		sink += (uintptr_t)dwarf->getEntryFromReference(references[i]);
+	});
+}
+
+void benchmarkConverter(Dwarf *dwarf)
+{
+	std::vector<Elf32_Off> userTypeReferences;
+	std::vector<Dwarf::Attribute*> typeAttributes[4];
+	const Elf32_Half typeAttributeNames[4] = { DW_AT_fund_type, DW_AT_user_def_type, DW_AT_mod_fund_type, DW_AT_mod_u_d_type };
+	const char *typeAttributeFixtures[4] =
+	{
+		"processTypeAttr fund_type",
+		"processTypeAttr user_def_type",
+		"processTypeAttr mod_fund_type",
+		"processTypeAttr mod_u_d_type"
+	};
+
+	for (Dwarf::Entry &entry : dwarf->entries)
+	{
+		for (Dwarf::Attribute &attr : entry.attributes)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				if (attr.name == typeAttributeNames[k])
+					typeAttributes[k].push_back(&attr);
+			}
+
+			if (attr.name == DW_AT_user_def_type)
+				userTypeReferences.push_back(attr.getReference());
+		}
+	}
+
+	shuffle(userTypeReferences);
+
+	run("findUserType", userTypeReferences.size(), [&](size_t i) {
+		Cpp::UserType *ut;
+		findUserType(dwarf, userTypeReferences[i], &ut);
+		sink += (uintptr_t)ut;
+	});
+
+	for (int k = 0; k < 4; k++)
+	{
+		shuffle(typeAttributes[k]);
+
+		run(typeAttributeFixtures[k], typeAttributes[k].size(), [&](size_t i) {
+			Cpp::Type type;
+			processTypeAttr(typeAttributes[k][i], &type);
+			sink += type.modifiers.size();
+		});
+	}
+}
+
+void benchmarkRenderer()
+{
+	std::vector<Cpp::Type*> types;
+	std::vector<Cpp::ClassType*> classes;
+
+	for (Cpp::File *file : cppFiles)
+	{
+		// Fill in the caches up front, as dwarf2cpp does before rendering
+		Cpp::ComputeLayouts(file);
+		Cpp::CacheNameFragments(file);
+
+		for (Cpp::Variable &v : file->variables)
+			types.push_back(&v.type);
+
+		for (Cpp::UserType *ut : file->userTypes)
+		{
+			if (ut->type != Cpp::UserType::CLASS && ut->type != Cpp::UserType::STRUCT && ut->type != Cpp::UserType::UNION)
+				continue;
+
+			classes.push_back(ut->classData);
+
+			for (Cpp::ClassType::Member &m : ut->classData->members)
+				types.push_back(&m.type);
+		}
+	}
+
+	shuffle(types);
+	shuffle(classes);
+
+	run("Type::toString", types.size(), [&](size_t i) {
+		sink += types[i]->toString().size();
+	});
+
+	// The body of a class is what ClassType::toBodyString used to return
+	Cpp::Emitter out;
+
+	run("ClassType::emitBody", classes.size(), [&](size_t i) {
+		out.clear();
+		classes[i]->emitBody(out, true);
+		sink += out.buffer.size();
+	});
+}
+
+int main(int argc, char **argv)
+{
+	const char *input = nullptr;
+
+	// Allocations include those made by the standard library on the
+	// function's behalf
+	AllocationTracker::Enable();
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--min-time" && i + 1 < argc)
+			minTime = std::max(0.0, atof(argv[++i]));
+		else if (arg == "--filter" && i + 1 < argc)
+			nameFilter = argv[++i];
+		else if (arg.compare(0, 2, "--") == 0 || input)
+		{
+			std::cout << "Usage: microbench [--min-time <seconds>] [--filter <substring>] [ELF file]" << std::endl;
+			return 1;
+		}
+		else
+			input = argv[i];
+	}
+
+	// Without a file, a small generated one gives every fixture samples
+	std::string generatedPath;
+
+	if (!input)
+	{
+		GeneratorOptions options;
+		options.units = 20;
+
+		generatedPath = (filesystem::temp_directory_path() / "microbench.elf").string();
+
+		size_t entryCount;
+
+		if (!generate(options, generatedPath.c_str(), &entryCount))
+			return 1;
+
+		input = generatedPath.c_str();
+	}
+
+	ElfFile *elf = new ElfFile(input);
+
+	if (elf->getError())
+	{
+		std::cout << "Failed to parse " << input << " as an ELF file. Error Code: " << elf->getError() << std::endl;
+		return 1;
+	}
+
+	// Keep the converter's progress messages out of the table
+	std::streambuf *stdoutBuffer = std::cout.rdbuf(nullptr);
+
+	Dwarf *dwarf = loadDwarf(elf);
+	bool processed = dwarf && processDwarf(dwarf);
+
+	std::cout.rdbuf(stdoutBuffer);
+
+	if (!generatedPath.empty())
+		filesystem::remove(generatedPath);
+
+	if (!processed)
+	{
+		std::cout << "Failed to convert " << input << std::endl;
+		return 1;
+	}
+
+	char header[160];
+	snprintf(header, sizeof(header), "%-36s %10s %12s %12s", "function", "samples", "ns/call", "allocs/call");
+	std::cout << header << std::endl;
+
+	benchmarkDecoder(dwarf);
+	benchmarkConverter(dwarf);
+	benchmarkRenderer();
+
+	return 0;
+}
@@ -0,0 +1,172 @@
+#include "trace.h"
+#include "json.h"
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+
+struct Event
+{
+	const char *name;
+	std::string detail;
+	int thread;
+	double start; // microseconds since Enable()
+	double duration;
+};
+
+static std::atomic<bool> enabled(false);
+static std::chrono::steady_clock::time_point startTime;
+
+static std::vector<Event> events;
+static std::map<int, std::string> threadNames;
+static int threadCount = 0;
+static std::mutex eventMutex;
+
+// Small numbers read better in the viewer than native thread ids
+static thread_local int threadIndex = -1;
+
+static double now()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+static int currentThread()
+{
+	if (threadIndex == -1)
+	{
+		std::lock_guard<std::mutex> lock(eventMutex);
+		threadIndex = threadCount++;
+	}
+
+	return threadIndex;
+}
+
+Trace::Span::Span(const char *name)
+{
+	m_name = name;
+	m_start = enabled ? now() : 0.0;
+}
+
+Trace::Span::Span(const char *name, const char *detail)
+{
+	m_name = name;
+	m_start = 0.0;
+
+	if (!enabled)
+		return;
+
+	if (detail)
+		m_detail = detail;
+
+	m_start = now();
+}
+
+Trace::Span::Span(const char *name, const std::experimental::filesystem::path &path)
+{
+	m_name = name;
+	m_start = 0.0;
+
+	if (!enabled)
+		return;
+
+	m_detail = path.generic_string();
+	m_start = now();
+}
+
+Trace::Span::~Span()
+{
+	if (!enabled)
+		return;
+
+	double end = now();
+	int thread = currentThread();
+
+	std::lock_guard<std::mutex> lock(eventMutex);
+	events.push_back({ m_name, std::move(m_detail), thread, m_start, end - m_start });
+}
+
+void Trace::Enable()
+{
+	startTime = std::chrono::steady_clock::now();
+	enabled = true;
+}
+
+bool Trace::IsEnabled()
+{
+	return enabled;
+}
+
+void Trace::SetThreadName(const std::string &name)
+{
+	if (!enabled)
+		return;
+
+	int thread = currentThread();
+
+	std::lock_guard<std::mutex> lock(eventMutex);
+	threadNames[thread] = name;
+}
+
+bool Trace::Save(const std::string &path)
+{
+	std::lock_guard<std::mutex> lock(eventMutex);
+
+	std::ofstream file(path, std::ios::binary);
+	std::string out = "{\"traceEvents\":[\n";
+	char buffer[128];
+	bool first = true;
+
+	for (auto &thread : threadNames)
+	{
+		snprintf(buffer, sizeof(buffer), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", thread.first);
+
+		out += first ? "" : ",\n";
+		out += buffer;
+		appendJsonString(out, thread.second);
+		out += "}}";
+		first = false;
+	}
+
+	for (const Event &event : events)
+	{
+		snprintf(buffer, sizeof(buffer), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", event.name,
+			event.thread, event.start, event.duration);
+
+		out += first ? "" : ",\n";
+		out += buffer;
+
+		if (!event.detail.empty())
+		{
+			out += ",\"args\":{\"name\":";
+			appendJsonString(out, event.detail);
+			out += "}";
+		}
+
+		out += "}";
+		first = false;
+
+		if (out.size() >= (1 << 20))
+		{
+			file.write(out.data(), out.size());
+			out.clear();
+		}
+	}
+
+	out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	file.write(out.data(), out.size());
+	file.close();
+
+	if (!file)
+	{
+		std::cout << "ERROR: Failed to write " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+// Records a timeline of what every thread was doing, for --trace. The file
+// is in the Chrome trace event format and opens in chrome://tracing or
+// Perfetto, with one row per thread.
+//
+// Spans are only recorded once Enable() has been called; until then a Span
+// costs a flag check.
+class Trace
+{
+public:
+	// Records the time from construction to destruction. The detail (a
+	// compile unit or file name) is shown with the span.
+	class Span
+	{
+	public:
+		Span(const char *name);
+		Span(const char *name, const char *detail);
+		Span(const char *name, const std::experimental::filesystem::path &path);
+		~Span();
+
+	private:
+		const char *m_name;
+		std::string m_detail;
+		double m_start;
+	};
+
+	static void Enable();
+	static bool IsEnabled();
+
+	// Names the calling thread's row, e.g. "reader"
+	static void SetThreadName(const std::string &name);
+
+	static bool Save(const std::string &path);
+};
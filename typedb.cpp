@@ -0,0 +1,890 @@
+#include "typedb.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+// Builds every section in memory as the files are walked, then writes them
+// out in one go
+class TypeDatabaseWriter : public Cpp::ModelVisitor
+{
+public:
+	std::string strings;
+	std::vector<TypeDatabase::FileRecord> files;
+	std::vector<uint32_t> fileUserTypes;
+	std::vector<TypeDatabase::UserTypeRecord> userTypes;
+	std::vector<TypeDatabase::TypeRecord> types;
+	std::vector<uint8_t> modifiers;
+	std::vector<TypeDatabase::MemberRecord> members;
+	std::vector<TypeDatabase::BaseRecord> bases;
+	std::vector<TypeDatabase::EnumeratorRecord> enumerators;
+	std::vector<int32_t> dimensions;
+	std::vector<TypeDatabase::ParameterRecord> parameters;
+	std::vector<TypeDatabase::VariableRecord> variables;
+	std::vector<TypeDatabase::FunctionRecord> functions;
+	std::vector<TypeDatabase::NameRecord> typeNames;
+	std::vector<TypeDatabase::AddressRecord> functionAddresses;
+	std::vector<uint32_t> nameSeeds;
+	std::vector<TypeDatabase::NameSlotRecord> nameSlots;
+	std::vector<TypeDatabase::NameRefRecord> nameRefs;
+	uint32_t nameHashSeed;
+
+	TypeDatabaseWriter();
+
+	void beginFile(Cpp::File *file) override;
+	void visitUserType(Cpp::UserType *ut) override;
+	void visitVariable(Cpp::Variable &v) override;
+	void visitFunction(Cpp::Function &f) override;
+
+	// Writes the user types and builds the indices, once every file has
+	// been walked
+	bool finish();
+	bool save(const std::string &path);
+
+private:
+	std::unordered_map<std::string, uint32_t> m_stringRefs;
+	std::unordered_map<std::string, uint32_t> m_typeRefs;
+	std::unordered_map<const Cpp::File*, uint32_t> m_fileIndices;
+	std::unordered_map<const Cpp::UserType*, uint32_t> m_userTypeIndices;
+	std::vector<Cpp::UserType*> m_userTypes;
+
+	uint32_t addString(const std::string &s);
+	uint32_t addType(Cpp::Type &type);
+	uint32_t addFundamentalType(Cpp::FundamentalType fundamentalType);
+	uint32_t addUserType(Cpp::UserType *ut);
+	void writeUserType(uint32_t index);
+	uint32_t addFunction(Cpp::Function &function, uint32_t file);
+	bool buildNameHash();
+	bool placeNames(const std::vector<uint32_t> &names, std::vector<uint32_t> *slots);
+};
+
+TypeDatabaseWriter::TypeDatabaseWriter()
+{
+	// The empty string is at 0, for missing names
+	strings += '\0';
+	m_stringRefs[""] = 0;
+
+	nameHashSeed = 0;
+}
+
+// A file's variables are contiguous since the walk visits them before the
+// functions, whose locals are added to the variables as well
+void TypeDatabaseWriter::beginFile(Cpp::File *file)
+{
+	m_fileIndices[file] = files.size();
+
+	TypeDatabase::FileRecord record;
+	record.name = addString(file->filename);
+	record.firstUserType = fileUserTypes.size();
+	record.userTypeCount = 0;
+	record.firstVariable = variables.size();
+	record.variableCount = 0;
+	record.firstFunction = functions.size();
+	record.functionCount = 0;
+
+	files.push_back(record);
+}
+
+void TypeDatabaseWriter::visitUserType(Cpp::UserType *ut)
+{
+	fileUserTypes.push_back(addUserType(ut));
+	files.back().userTypeCount++;
+}
+
+void TypeDatabaseWriter::visitVariable(Cpp::Variable &v)
+{
+	variables.push_back({ addString(v.name), addType(v.type), (uint32_t)v.isGlobal });
+	files.back().variableCount++;
+}
+
+void TypeDatabaseWriter::visitFunction(Cpp::Function &f)
+{
+	addFunction(f, files.size() - 1);
+	files.back().functionCount++;
+}
+
+bool TypeDatabaseWriter::finish()
+{
+	// User types are written in the order they were first referred to.
+	// Writing one can refer to more, which are appended and written in turn.
+	for (size_t i = 0; i < m_userTypes.size(); i++)
+		writeUserType(i);
+
+	for (size_t i = 0; i < userTypes.size(); i++)
+	{
+		if (userTypes[i].name != 0)
+			typeNames.push_back({ userTypes[i].name, (uint32_t)i });
+	}
+
+	std::stable_sort(typeNames.begin(), typeNames.end(), [this](const TypeDatabase::NameRecord &a, const TypeDatabase::NameRecord &b) {
+		return strcmp(&strings[a.name], &strings[b.name]) < 0;
+	});
+
+	for (size_t i = 0; i < functions.size(); i++)
+	{
+		if (functions[i].address != 0)
+			functionAddresses.push_back({ functions[i].address, (uint32_t)i });
+	}
+
+	std::stable_sort(functionAddresses.begin(), functionAddresses.end(), [](const TypeDatabase::AddressRecord &a, const TypeDatabase::AddressRecord &b) {
+		return a.address < b.address;
+	});
+
+	return buildNameHash();
+}
+
+uint32_t TypeDatabaseWriter::addString(const std::string &s)
+{
+	auto it = m_stringRefs.find(s);
+
+	if (it != m_stringRefs.end())
+		return it->second;
+
+	uint32_t ref = strings.size();
+
+	strings += s;
+	strings += '\0';
+	m_stringRefs[s] = ref;
+
+	return ref;
+}
+
+// Identical types are only stored once
+uint32_t TypeDatabaseWriter::addType(Cpp::Type &type)
+{
+	TypeDatabase::TypeRecord record;
+	record.isFundamental = type.isFundamentalType;
+	record.target = type.isFundamentalType ? (uint32_t)type.fundamentalType : addUserType(type.userType);
+	record.modifierCount = type.modifiers.size();
+	record.firstModifier = 0;
+
+	std::string key((const char*)&record.target, sizeof(record.target));
+	key += (char)record.isFundamental;
+
+	for (Cpp::Type::Modifier m : type.modifiers)
+		key += (char)m;
+
+	auto it = m_typeRefs.find(key);
+
+	if (it != m_typeRefs.end())
+		return it->second;
+
+	record.firstModifier = modifiers.size();
+
+	for (Cpp::Type::Modifier m : type.modifiers)
+		modifiers.push_back((uint8_t)m);
+
+	uint32_t index = types.size();
+
+	types.push_back(record);
+	m_typeRefs[key] = index;
+
+	return index;
+}
+
+uint32_t TypeDatabaseWriter::addFundamentalType(Cpp::FundamentalType fundamentalType)
+{
+	Cpp::Type type;
+	type.isFundamentalType = true;
+	type.fundamentalType = fundamentalType;
+
+	return addType(type);
+}
+
+// Returns the index the type will be written at
+uint32_t TypeDatabaseWriter::addUserType(Cpp::UserType *ut)
+{
+	if (!ut)
+		return TypeDatabase::NONE;
+
+	auto it = m_userTypeIndices.find(ut);
+
+	if (it != m_userTypeIndices.end())
+		return it->second;
+
+	uint32_t index = m_userTypes.size();
+
+	m_userTypes.push_back(ut);
+	m_userTypeIndices[ut] = index;
+
+	return index;
+}
+
+void TypeDatabaseWriter::writeUserType(uint32_t index)
+{
+	Cpp::UserType *ut = m_userTypes[index];
+
+	ut->computeLayout();
+
+	TypeDatabase::UserTypeRecord record;
+	record.kind = ut->type;
+	record.name = addString(ut->name);
+	record.size = ut->byteSize;
+	record.alignment = ut->byteAlignment;
+	record.first = 0;
+	record.count = 0;
+	record.firstBase = 0;
+	record.baseCount = 0;
+	record.firstFunction = 0;
+	record.functionCount = 0;
+	record.type = TypeDatabase::NONE;
+
+	auto file = m_fileIndices.find(ut->file);
+	record.file = (file != m_fileIndices.end()) ? file->second : TypeDatabase::NONE;
+
+	switch (ut->type)
+	{
+	case Cpp::UserType::CLASS:
+	case Cpp::UserType::STRUCT:
+	case Cpp::UserType::UNION:
+	{
+		Cpp::ClassType *c = ut->classData;
+
+		record.firstBase = bases.size();
+		record.baseCount = c->inheritances.size();
+
+		for (Cpp::ClassType::Inheritance &i : c->inheritances)
+			bases.push_back({ addType(i.type), i.offset });
+
+		record.first = members.size();
+		record.count = c->members.size();
+
+		for (Cpp::ClassType::Member &m : c->members)
+			members.push_back({ addString(m.name), addType(m.type), m.offset, m.bit_offset, m.bit_size });
+
+		// Member functions are written once their owner's record is in place
+		break;
+	}
+	case Cpp::UserType::ENUM:
+	{
+		Cpp::EnumType *e = ut->enumData;
+
+		record.type = addFundamentalType(e->baseType);
+		record.first = enumerators.size();
+		record.count = e->elements.size();
+
+		for (Cpp::EnumType::Element &element : e->elements)
+			enumerators.push_back({ (int64_t)element.constValue, addString(element.name), 0 });
+
+		break;
+	}
+	case Cpp::UserType::ARRAY:
+	{
+		Cpp::ArrayType *a = ut->arrayData;
+
+		record.type = addType(a->type);
+		record.first = dimensions.size();
+		record.count = a->dimensions.size();
+
+		for (Cpp::ArrayType::Dimension &d : a->dimensions)
+			dimensions.push_back(d.size);
+
+		break;
+	}
+	case Cpp::UserType::FUNCTION:
+	{
+		Cpp::FunctionType *f = ut->functionData;
+
+		record.type = addType(f->returnType);
+		record.first = parameters.size();
+		record.count = f->parameters.size();
+
+		for (Cpp::FunctionType::Parameter &p : f->parameters)
+			parameters.push_back({ addString(p.name), addType(p.type) });
+
+		break;
+	}
+	}
+
+	userTypes.push_back(record);
+
+	if (ut->type == Cpp::UserType::CLASS || ut->type == Cpp::UserType::STRUCT || ut->type == Cpp::UserType::UNION)
+	{
+		uint32_t first = functions.size();
+
+		for (Cpp::Function &f : ut->classData->functions)
+			addFunction(f, record.file);
+
+		userTypes[index].firstFunction = first;
+		userTypes[index].functionCount = ut->classData->functions.size();
+	}
+}
+
+uint32_t TypeDatabaseWriter::addFunction(Cpp::Function &function, uint32_t file)
+{
+	TypeDatabase::FunctionRecord record;
+	record.name = addString(function.name);
+	record.mangledName = addString(function.mangledName);
+	record.address = function.startAddress;
+	record.returnType = addType(function.returnType);
+	record.owner = addUserType(function.typeOwner);
+	record.file = file;
+	record.isGlobal = function.isGlobal;
+
+	record.firstParameter = parameters.size();
+	record.parameterCount = function.parameters.size();
+
+	for (Cpp::FunctionType::Parameter &p : function.parameters)
+		parameters.push_back({ addString(p.name), addType(p.type) });
+
+	record.firstLocal = variables.size();
+	record.localCount = function.variables.size();
+
+	for (Cpp::Variable &v : function.variables)
+		variables.push_back({ addString(v.name), addType(v.type), (uint32_t)v.isGlobal });
+
+	uint32_t index = functions.size();
+	functions.push_back(record);
+
+	return index;
+}
+
+// Hash and displace: names are split into buckets by hash, and each bucket,
+// largest first, gets the first seed that sends all of its names to slots
+// that are still free
+bool TypeDatabaseWriter::buildNameHash()
+{
+	struct Ref
+	{
+		uint32_t name; // index into names
+		TypeDatabase::NameRefRecord ref;
+	};
+
+	std::vector<uint32_t> names; // string refs
+	std::vector<Ref> refs;
+	std::unordered_map<uint32_t, uint32_t> nameIndices;
+
+	auto addName = [&](uint32_t name, uint32_t kind, uint32_t index) {
+		if (name == 0)
+			return;
+
+		auto it = nameIndices.emplace(name, names.size());
+
+		if (it.second)
+			names.push_back(name);
+
+		refs.push_back({ it.first->second, { kind, index } });
+	};
+
+	for (size_t i = 0; i < userTypes.size(); i++)
+		addName(userTypes[i].name, TypeDatabase::NAME_TYPE, i);
+
+	for (size_t i = 0; i < functions.size(); i++)
+	{
+		addName(functions[i].name, TypeDatabase::NAME_FUNCTION, i);
+		addName(functions[i].mangledName, TypeDatabase::NAME_MANGLED_NAME, i);
+	}
+
+	if (names.empty())
+		return true;
+
+	// Names that can't be placed are hashed again from scratch with another
+	// seed, which is almost never needed more than once
+	const uint32_t MAX_NAME_HASH_SEEDS = 16;
+	std::vector<uint32_t> slots;
+
+	for (nameHashSeed = 0; nameHashSeed < MAX_NAME_HASH_SEEDS; nameHashSeed++)
+	{
+		if (placeNames(names, &slots))
+			break;
+	}
+
+	if (nameHashSeed == MAX_NAME_HASH_SEEDS)
+	{
+		std::cout << "ERROR: Failed to build the name hash of the type database" << std::endl;
+		return false;
+	}
+
+	uint32_t slotCount = names.size();
+
+	// Each slot's refs are contiguous, in the order they were added
+	std::vector<uint32_t> refStart(slotCount + 1, 0);
+
+	for (const Ref &ref : refs)
+		refStart[ref.name + 1]++;
+
+	for (uint32_t i = 0; i < slotCount; i++)
+		refStart[i + 1] += refStart[i];
+
+	nameSlots.resize(slotCount);
+
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		uint32_t name = slots[i];
+		nameSlots[i] = { names[name], refStart[name], refStart[name + 1] - refStart[name] };
+	}
+
+	nameRefs.resize(refs.size());
+
+	for (const Ref &ref : refs)
+		nameRefs[refStart[ref.name]++] = ref.ref;
+
+	return true;
+}
+
+// Gives every name (an index into names) its own slot, hashing them with
+// nameHashSeed. Fails if two names have the same hash, since no bucket seed
+// can tell them apart, or if a bucket finds no free slots within the seed
+// limit.
+bool TypeDatabaseWriter::placeNames(const std::vector<uint32_t> &names, std::vector<uint32_t> *slots)
+{
+	uint32_t slotCount = names.size();
+	uint32_t bucketCount = slotCount / 2 + 1;
+
+	// Names grouped by bucket, with the buckets' start in bucketStart
+	std::vector<uint64_t> hashes(slotCount);
+	std::vector<uint32_t> bucketStart(bucketCount + 1, 0);
+	std::vector<uint32_t> bucketNames(slotCount);
+
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		hashes[i] = TypeDatabase::HashName(&strings[names[i]], nameHashSeed);
+		bucketStart[hashes[i] % bucketCount + 1]++;
+	}
+
+	for (uint32_t b = 0; b < bucketCount; b++)
+		bucketStart[b + 1] += bucketStart[b];
+
+	{
+		std::vector<uint32_t> next(bucketStart.begin(), bucketStart.end() - 1);
+
+		for (uint32_t i = 0; i < slotCount; i++)
+			bucketNames[next[hashes[i] % bucketCount]++] = i;
+	}
+
+	std::vector<uint32_t> order(bucketCount);
+
+	for (uint32_t b = 0; b < bucketCount; b++)
+		order[b] = b;
+
+	std::stable_sort(order.begin(), order.end(), [&bucketStart](uint32_t a, uint32_t b) {
+		return bucketStart[a + 1] - bucketStart[a] > bucketStart[b + 1] - bucketStart[b];
+	});
+
+	// The last buckets placed have few free slots left, and take about
+	// slotCount / free slots tries each
+	const uint32_t seedLimit = (uint32_t)std::min<uint64_t>(std::max<uint64_t>((uint64_t)slotCount * 16, 1 << 16), 0xffffffff);
+	const uint32_t EMPTY = TypeDatabase::NONE;
+
+	std::vector<uint32_t> bucketSlots;
+
+	slots->assign(slotCount, EMPTY);
+	nameSeeds.assign(bucketCount, 0);
+
+	for (uint32_t b : order)
+	{
+		uint32_t start = bucketStart[b];
+		uint32_t size = bucketStart[b + 1] - start;
+
+		if (size == 0)
+			break;
+
+		for (uint32_t i = 1; i < size; i++)
+		{
+			for (uint32_t j = 0; j < i; j++)
+			{
+				if (hashes[bucketNames[start + i]] == hashes[bucketNames[start + j]])
+					return false;
+			}
+		}
+
+		uint32_t seed;
+
+		for (seed = 0; seed < seedLimit; seed++)
+		{
+			bucketSlots.clear();
+
+			for (uint32_t i = 0; i < size; i++)
+			{
+				uint32_t slot = TypeDatabase::SlotHash(hashes[bucketNames[start + i]], seed) % slotCount;
+
+				if ((*slots)[slot] != EMPTY || std::find(bucketSlots.begin(), bucketSlots.end(), slot) != bucketSlots.end())
+					break;
+
+				bucketSlots.push_back(slot);
+			}
+
+			if (bucketSlots.size() == size)
+				break;
+		}
+
+		if (seed == seedLimit)
+			return false;
+
+		for (uint32_t i = 0; i < size; i++)
+			(*slots)[bucketSlots[i]] = bucketNames[start + i];
+
+		nameSeeds[b] = seed;
+	}
+
+	return true;
+}
+
+bool TypeDatabaseWriter::save(const std::string &path)
+{
+	TypeDatabase::Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "D2CTYPES", sizeof(header.magic));
+	header.version = TypeDatabase::VERSION;
+	header.byteOrder = 0x01020304;
+	header.nameHashSeed = nameHashSeed;
+
+	struct
+	{
+		const void *data;
+		size_t size;
+		size_t count;
+	}
+	sections[TypeDatabase::SECTION_COUNT] =
+	{
+		{ strings.data(), strings.size(), strings.size() },
+		{ files.data(), files.size() * sizeof(files[0]), files.size() },
+		{ fileUserTypes.data(), fileUserTypes.size() * sizeof(fileUserTypes[0]), fileUserTypes.size() },
+		{ userTypes.data(), userTypes.size() * sizeof(userTypes[0]), userTypes.size() },
+		{ types.data(), types.size() * sizeof(types[0]), types.size() },
+		{ modifiers.data(), modifiers.size(), modifiers.size() },
+		{ members.data(), members.size() * sizeof(members[0]), members.size() },
+		{ bases.data(), bases.size() * sizeof(bases[0]), bases.size() },
+		{ enumerators.data(), enumerators.size() * sizeof(enumerators[0]), enumerators.size() },
+		{ dimensions.data(), dimensions.size() * sizeof(dimensions[0]), dimensions.size() },
+		{ parameters.data(), parameters.size() * sizeof(parameters[0]), parameters.size() },
+		{ variables.data(), variables.size() * sizeof(variables[0]), variables.size() },
+		{ functions.data(), functions.size() * sizeof(functions[0]), functions.size() },
+		{ typeNames.data(), typeNames.size() * sizeof(typeNames[0]), typeNames.size() },
+		{ functionAddresses.data(), functionAddresses.size() * sizeof(functionAddresses[0]), functionAddresses.size() },
+		{ nameSeeds.data(), nameSeeds.size() * sizeof(nameSeeds[0]), nameSeeds.size() },
+		{ nameSlots.data(), nameSlots.size() * sizeof(nameSlots[0]), nameSlots.size() },
+		{ nameRefs.data(), nameRefs.size() * sizeof(nameRefs[0]), nameRefs.size() }
+	};
+
+	uint64_t offset = sizeof(header);
+
+	for (int i = 0; i < TypeDatabase::SECTION_COUNT; i++)
+	{
+		offset = (offset + 7) & ~(uint64_t)7;
+
+		header.sections[i].offset = offset;
+		header.sections[i].count = sections[i].count;
+
+		offset += sections[i].size;
+	}
+
+	if (offset > 0xffffffff)
+	{
+		std::cout << "ERROR: The type database would be larger than 4 GB" << std::endl;
+		return false;
+	}
+
+	header.size = offset;
+
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char*)&header, sizeof(header));
+
+	static const char padding[8] = {};
+	uint64_t written = sizeof(header);
+
+	for (int i = 0; i < TypeDatabase::SECTION_COUNT; i++)
+	{
+		file.write(padding, header.sections[i].offset - written);
+		file.write((const char*)sections[i].data, sections[i].size);
+
+		written = header.sections[i].offset + sections[i].size;
+	}
+
+	file.close();
+
+	if (!file)
+	{
+		std::cout << "ERROR: Failed to write " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool TypeDatabase::Save(const std::vector<Cpp::File*> &files, const std::string &path)
+{
+	TypeDatabaseWriter writer;
+
+	for (Cpp::File *file : files)
+		Cpp::Walk(file, false, { &writer });
+
+	if (!writer.finish())
+		return false;
+
+	return writer.save(path);
+}
+
+static bool verifyError(const std::string &path, const std::string &message)
+{
+	std::cout << "ERROR: " << path << " doesn't read back: " << message << std::endl;
+	return false;
+}
+
+bool TypeDatabase::Verify(const std::string &path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file)
+		return verifyError(path, "failed to open it");
+
+	size_t size = file.tellg();
+
+	// Records are read in place, so the data has to be 8 byte aligned
+	std::vector<uint64_t> buffer((size + 7) / 8);
+
+	file.seekg(0);
+	file.read((char*)buffer.data(), size);
+
+	TypeDatabase db;
+
+	if (!file || !db.open(buffer.data(), size))
+		return verifyError(path, "the header or a section is invalid");
+
+	uint32_t userTypeCount, functionCount, typeNameCount, addressCount, slotCount;
+	const UserTypeRecord *userTypes = db.get<UserTypeRecord>(USER_TYPES, &userTypeCount);
+	const FunctionRecord *functions = db.get<FunctionRecord>(FUNCTIONS, &functionCount);
+	const NameRecord *typeNames = db.get<NameRecord>(TYPE_NAMES, &typeNameCount);
+	const AddressRecord *addresses = db.get<AddressRecord>(FUNCTION_ADDRESSES, &addressCount);
+	const NameSlotRecord *slots = db.get<NameSlotRecord>(NAME_SLOTS, &slotCount);
+	const NameRefRecord *refs = db.get<NameRefRecord>(NAME_REFS);
+
+	// Every named type has to be in TYPE_NAMES once, and findTypeName has to
+	// find the first of the types with its name
+	std::vector<bool> seen(userTypeCount, false);
+
+	for (uint32_t i = 0; i < typeNameCount; i++)
+	{
+		const char *name = db.getString(typeNames[i].name);
+		uint32_t found = db.findTypeName(name);
+
+		if (found == NONE || found > i || strcmp(db.getString(typeNames[found].name), name) != 0 ||
+			(found < i && strcmp(db.getString(typeNames[i - 1].name), name) != 0))
+			return verifyError(path, std::string("type name '") + name + "' isn't found");
+
+		if (typeNames[i].userType >= userTypeCount || seen[typeNames[i].userType])
+			return verifyError(path, std::string("type name '") + name + "' refers to the wrong type");
+
+		seen[typeNames[i].userType] = true;
+	}
+
+	for (uint32_t i = 0; i < userTypeCount; i++)
+	{
+		if (userTypes[i].name != 0 && !seen[i])
+			return verifyError(path, std::string("type '") + db.getString(userTypes[i].name) + "' has no type name record");
+	}
+
+	uint32_t addressedCount = 0;
+
+	for (uint32_t i = 0; i < functionCount; i++)
+	{
+		if (functions[i].address != 0)
+			addressedCount++;
+	}
+
+	if (addressCount != addressedCount)
+		return verifyError(path, "functions are missing from the address index");
+
+	for (uint32_t i = 0; i < addressCount; i++)
+	{
+		uint32_t found = db.findFunction(addresses[i].address);
+
+		if (found >= functionCount || functions[found].address != addresses[i].address)
+			return verifyError(path, "the function at " + std::to_string(addresses[i].address) + " isn't found");
+	}
+
+	// Every slot's name has to hash to that slot, and between them the slots
+	// have to refer to every named type and function exactly once
+	std::vector<uint8_t> named[3] =
+	{
+		std::vector<uint8_t>(userTypeCount, 0),
+		std::vector<uint8_t>(functionCount, 0),
+		std::vector<uint8_t>(functionCount, 0)
+	};
+
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		const char *name = db.getString(slots[i].name);
+		uint32_t count;
+		const NameRefRecord *found = db.findName(name, &count);
+
+		if (found != refs + slots[i].firstRef || count != slots[i].refCount)
+			return verifyError(path, std::string("name '") + name + "' isn't found through the name hash");
+
+		for (uint32_t j = 0; j < count; j++)
+		{
+			uint32_t kind = found[j].kind;
+			uint32_t index = found[j].index;
+			uint32_t expected;
+
+			if (kind == NAME_TYPE && index < userTypeCount)
+				expected = userTypes[index].name;
+			else if (kind == NAME_FUNCTION && index < functionCount)
+				expected = functions[index].name;
+			else if (kind == NAME_MANGLED_NAME && index < functionCount)
+				expected = functions[index].mangledName;
+			else
+				return verifyError(path, std::string("name '") + name + "' has an invalid reference");
+
+			if (strcmp(db.getString(expected), name) != 0 || named[kind][index]++)
+				return verifyError(path, std::string("name '") + name + "' refers to the wrong record");
+		}
+	}
+
+	for (uint32_t i = 0; i < userTypeCount; i++)
+	{
+		if (userTypes[i].name != 0 && !named[NAME_TYPE][i])
+			return verifyError(path, std::string("type '") + db.getString(userTypes[i].name) + "' isn't in the name hash");
+	}
+
+	for (uint32_t i = 0; i < functionCount; i++)
+	{
+		if ((functions[i].name != 0 && !named[NAME_FUNCTION][i]) || (functions[i].mangledName != 0 && !named[NAME_MANGLED_NAME][i]))
+			return verifyError(path, std::string("function '") + db.getString(functions[i].name) + "' isn't in the name hash");
+	}
+
+	return true;
+}
+
+TypeDatabase::TypeDatabase()
+{
+	m_data = nullptr;
+	m_size = 0;
+	m_header = nullptr;
+}
+
+bool TypeDatabase::open(const void *data, size_t size)
+{
+	const Header *header = (const Header*)data;
+
+	if (size < sizeof(Header) || memcmp(header->magic, "D2CTYPES", sizeof(header->magic)) != 0 ||
+		header->version != VERSION || header->byteOrder != 0x01020304 || header->size > size)
+		return false;
+
+	static const size_t recordSizes[SECTION_COUNT] =
+	{
+		1,
+		sizeof(FileRecord),
+		sizeof(uint32_t),
+		sizeof(UserTypeRecord),
+		sizeof(TypeRecord),
+		sizeof(uint8_t),
+		sizeof(MemberRecord),
+		sizeof(BaseRecord),
+		sizeof(EnumeratorRecord),
+		sizeof(int32_t),
+		sizeof(ParameterRecord),
+		sizeof(VariableRecord),
+		sizeof(FunctionRecord),
+		sizeof(NameRecord),
+		sizeof(AddressRecord),
+		sizeof(uint32_t),
+		sizeof(NameSlotRecord),
+		sizeof(NameRefRecord)
+	};
+
+	for (int i = 0; i < SECTION_COUNT; i++)
+	{
+		uint64_t end = (uint64_t)header->sections[i].offset + (uint64_t)header->sections[i].count * recordSizes[i];
+
+		if (header->sections[i].offset % 8 != 0 || end > header->size)
+			return false;
+	}
+
+	if (header->sections[NAME_SLOTS].count != 0 && header->sections[NAME_SEEDS].count == 0)
+		return false;
+
+	// Every string ends inside the table as long as the table does
+	const SectionRecord &strings = header->sections[STRINGS];
+
+	if (strings.count == 0 || ((const char*)data)[strings.offset + strings.count - 1] != '\0')
+		return false;
+
+	m_data = (const char*)data;
+	m_size = size;
+	m_header = header;
+
+	return true;
+}
+
+uint32_t TypeDatabase::findTypeName(const char *name) const
+{
+	uint32_t count;
+	const NameRecord *names = get<NameRecord>(TYPE_NAMES, &count);
+
+	const NameRecord *it = std::lower_bound(names, names + count, name, [this](const NameRecord &record, const char *name) {
+		return strcmp(getString(record.name), name) < 0;
+	});
+
+	if (it == names + count || strcmp(getString(it->name), name) != 0)
+		return NONE;
+
+	return it - names;
+}
+
+uint32_t TypeDatabase::findFunction(uint32_t address) const
+{
+	uint32_t count;
+	const AddressRecord *addresses = get<AddressRecord>(FUNCTION_ADDRESSES, &count);
+
+	const AddressRecord *it = std::lower_bound(addresses, addresses + count, address, [](const AddressRecord &record, uint32_t address) {
+		return record.address < address;
+	});
+
+	if (it == addresses + count || it->address != address)
+		return NONE;
+
+	return it->function;
+}
+
+const TypeDatabase::NameRefRecord *TypeDatabase::findName(const char *name, uint32_t *count) const
+{
+	uint32_t seedCount, slotCount;
+	const uint32_t *seeds = get<uint32_t>(NAME_SEEDS, &seedCount);
+	const NameSlotRecord *slots = get<NameSlotRecord>(NAME_SLOTS, &slotCount);
+
+	*count = 0;
+
+	if (slotCount == 0)
+		return nullptr;
+
+	uint64_t hash = HashName(name, m_header->nameHashSeed);
+	const NameSlotRecord &slot = slots[SlotHash(hash, seeds[hash % seedCount]) % slotCount];
+
+	if (strcmp(getString(slot.name), name) != 0)
+		return nullptr;
+
+	*count = slot.refCount;
+
+	return get<NameRefRecord>(NAME_REFS) + slot.firstRef;
+}
+
+// 64-bit FNV-1a, with the seed mixed into the offset basis
+uint64_t TypeDatabase::HashName(const char *name, uint32_t seed)
+{
+	uint64_t hash = 0xcbf29ce484222325 ^ (seed * 0x9e3779b97f4a7c15);
+
+	for (const unsigned char *c = (const unsigned char*)name; *c; c++)
+	{
+		hash ^= *c;
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+// The finalizer from MurmurHash3, so every seed gives a different spread
+uint32_t TypeDatabase::SlotHash(uint64_t hash, uint32_t seed)
+{
+	uint64_t h = hash + (seed + 1) * 0x9e3779b97f4a7c15;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccd;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53;
+	h ^= h >> 33;
+
+	return (uint32_t)h;
+}
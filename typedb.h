@@ -0,0 +1,250 @@
+#pragma once
+
+#include "cpp.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The converted model as a single binary file (--typedb), for tools that
+// need the types rather than C++ source. The file is made to be mapped into
+// memory and read in place: every record has a fixed size, references are
+// indices into other sections or offsets into the string table, and type
+// names and function addresses have sorted indices for binary search.
+//
+// Names (type names, function names and mangled names) can also be looked
+// up through a minimal perfect hash that's built when the file is written,
+// so reading it needs no setup: see findName().
+//
+// Layout: a Header, then the sections it lists, each an array of records
+// starting on an 8 byte boundary. Everything is in the byte order of the
+// machine that wrote the file, which byteOrder records; in practice that's
+// always little-endian.
+class TypeDatabase
+{
+public:
+	static const uint32_t VERSION = 2;
+	static const uint32_t NONE = 0xffffffff; // missing reference
+
+	enum Section
+	{
+		STRINGS,         // NUL terminated strings; count is the size in bytes
+		FILES,           // FileRecord
+		FILE_USER_TYPES, // uint32_t user type indices, referenced by FileRecord
+		USER_TYPES,      // UserTypeRecord
+		TYPES,           // TypeRecord
+		MODIFIERS,       // uint8_t Cpp::Type::Modifier, referenced by TypeRecord
+		MEMBERS,         // MemberRecord
+		BASES,           // BaseRecord
+		ENUMERATORS,     // EnumeratorRecord
+		DIMENSIONS,      // int32_t array dimension sizes
+		PARAMETERS,      // ParameterRecord
+		VARIABLES,       // VariableRecord, both globals and locals
+		FUNCTIONS,       // FunctionRecord, both functions and member functions
+		TYPE_NAMES,      // NameRecord sorted by name
+		FUNCTION_ADDRESSES, // AddressRecord sorted by address
+		NAME_SEEDS,      // uint32_t per hash bucket, see findName()
+		NAME_SLOTS,      // NameSlotRecord, one per distinct name
+		NAME_REFS,       // NameRefRecord, referenced by NameSlotRecord
+		SECTION_COUNT
+	};
+
+	struct SectionRecord
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	struct Header
+	{
+		char magic[8]; // "D2CTYPES"
+		uint32_t version;
+		uint32_t byteOrder; // 0x01020304 as written
+		uint32_t size;      // of the whole file
+		uint32_t nameHashSeed; // see findName()
+		SectionRecord sections[SECTION_COUNT];
+	};
+
+	struct FileRecord
+	{
+		uint32_t name;
+		uint32_t firstUserType; // into FILE_USER_TYPES
+		uint32_t userTypeCount;
+		uint32_t firstVariable;
+		uint32_t variableCount;
+		uint32_t firstFunction;
+		uint32_t functionCount;
+	};
+
+	// A type as used by a member, variable, parameter etc.: a fundamental
+	// type (Cpp::FundamentalType) or a user type index, with modifiers in
+	// the order of Cpp::Type::modifiers
+	struct TypeRecord
+	{
+		uint32_t target;
+		uint16_t isFundamental;
+		uint16_t modifierCount;
+		uint32_t firstModifier;
+	};
+
+	// first/count refer to MEMBERS, ENUMERATORS, DIMENSIONS or PARAMETERS
+	// depending on the kind. type is the element type of arrays and the
+	// return type of function types, and for enums a fundamental TypeRecord
+	// of the underlying type.
+	struct UserTypeRecord
+	{
+		uint32_t kind; // same order as Cpp::UserType's
+		uint32_t name;
+		uint32_t file; // NONE if the type isn't in any file
+		int32_t size;  // -1 if unknown
+		int32_t alignment;
+		uint32_t first;
+		uint32_t count;
+		uint32_t firstBase;
+		uint32_t baseCount;
+		uint32_t firstFunction;
+		uint32_t functionCount;
+		uint32_t type;
+	};
+
+	struct MemberRecord
+	{
+		uint32_t name;
+		uint32_t type;
+		int32_t offset;
+		int32_t bitOffset; // both -1 if not a bitfield
+		int32_t bitSize;
+	};
+
+	struct BaseRecord
+	{
+		uint32_t type;
+		int32_t offset;
+	};
+
+	struct EnumeratorRecord
+	{
+		int64_t value;
+		uint32_t name;
+		uint32_t reserved;
+	};
+
+	struct ParameterRecord
+	{
+		uint32_t name;
+		uint32_t type;
+	};
+
+	struct VariableRecord
+	{
+		uint32_t name;
+		uint32_t type;
+		uint32_t isGlobal;
+	};
+
+	struct FunctionRecord
+	{
+		uint32_t name;
+		uint32_t mangledName;
+		uint32_t address;
+		uint32_t returnType;
+		uint32_t firstParameter;
+		uint32_t parameterCount;
+		uint32_t firstLocal; // into VARIABLES
+		uint32_t localCount;
+		uint32_t owner; // class user type, or NONE
+		uint32_t file;
+		uint32_t isGlobal;
+	};
+
+	struct NameRecord
+	{
+		uint32_t name;
+		uint32_t userType;
+	};
+
+	struct AddressRecord
+	{
+		uint32_t address;
+		uint32_t function;
+	};
+
+	enum NameKind
+	{
+		NAME_TYPE,          // index is a user type
+		NAME_FUNCTION,      // index is a function, by its name
+		NAME_MANGLED_NAME   // index is a function, by its mangled name
+	};
+
+	struct NameSlotRecord
+	{
+		uint32_t name;
+		uint32_t firstRef;
+		uint32_t refCount;
+	};
+
+	struct NameRefRecord
+	{
+		uint32_t kind;
+		uint32_t index;
+	};
+
+	// Writes every file's types, variables and functions, along with the
+	// user types they refer to
+	static bool Save(const std::vector<Cpp::File*> &files, const std::string &path);
+
+	// Reads the file back and looks up every type name, function address
+	// and name through the indices and the name hash, to check that each
+	// finds the records it should
+	static bool Verify(const std::string &path);
+
+	TypeDatabase();
+
+	// Checks the header and that every section lies inside the data, which
+	// must stay valid and 8 byte aligned while the database is used.
+	// References inside records aren't checked.
+	bool open(const void *data, size_t size);
+
+	template<class T>
+	const T *get(Section section, uint32_t *count = nullptr) const
+	{
+		if (count)
+			*count = m_header->sections[section].count;
+
+		return (const T*)(m_data + m_header->sections[section].offset);
+	}
+
+	inline uint32_t getCount(Section section) const
+	{
+		return m_header->sections[section].count;
+	}
+
+	inline const char *getString(uint32_t ref) const
+	{
+		return m_data + m_header->sections[STRINGS].offset + ref;
+	}
+
+	// Index in TYPE_NAMES of the first type with that name, or NONE. Types
+	// with the same name (from different compile units) follow it.
+	uint32_t findTypeName(const char *name) const;
+
+	// Function starting at the address, or NONE
+	uint32_t findFunction(uint32_t address) const;
+
+	// Every type and function with that name or mangled name, in the order
+	// they were written, or nullptr if there are none. A name's slot is
+	// SlotHash(hash, seeds[hash % seed count]) % slot count, where hash is
+	// HashName(name, nameHashSeed from the header); the name in the slot then
+	// has to be compared, since names that aren't in the file land in some
+	// slot as well.
+	const NameRefRecord *findName(const char *name, uint32_t *count) const;
+
+	static uint64_t HashName(const char *name, uint32_t seed);
+	static uint32_t SlotHash(uint64_t hash, uint32_t seed);
+
+private:
+	const char *m_data;
+	size_t m_size;
+	const Header *m_header;
+};
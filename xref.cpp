@@ -0,0 +1,227 @@
+#include "xref.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+UsageIndex::UsageIndex(const std::vector<Cpp::File*> &files)
+{
+	m_useCount = 0;
+
+	for (Cpp::File *file : files)
+	{
+		for (Cpp::UserType *ut : file->userTypes)
+		{
+			if (ut->type != Cpp::UserType::CLASS && ut->type != Cpp::UserType::STRUCT && ut->type != Cpp::UserType::UNION)
+				continue;
+
+			Use use = { BASE, file, ut, nullptr, nullptr };
+
+			for (Cpp::ClassType::Inheritance &i : ut->classData->inheritances)
+				add(i.type, use);
+
+			use.kind = MEMBER;
+
+			for (Cpp::ClassType::Member &m : ut->classData->members)
+			{
+				use.name = &m.name;
+				add(m.type, use);
+			}
+
+			// Member functions are copies of definitions that are indexed
+			// with the file's functions below
+		}
+
+		for (Cpp::Variable &v : file->variables)
+		{
+			Use use = { VARIABLE, file, nullptr, nullptr, &v.name };
+			add(v.type, use);
+		}
+
+		for (Cpp::Function &f : file->functions)
+			addFunction(file, f, f.typeOwner);
+	}
+}
+
+void UsageIndex::addFunction(Cpp::File *file, Cpp::Function &function, Cpp::UserType *ownerType)
+{
+	Use use = { RETURN, file, ownerType, &function, nullptr };
+	add(function.returnType, use);
+
+	use.kind = PARAMETER;
+
+	for (Cpp::FunctionType::Parameter &p : function.parameters)
+	{
+		use.name = &p.name;
+		add(p.type, use);
+	}
+
+	use.kind = LOCAL;
+
+	for (Cpp::Variable &v : function.variables)
+	{
+		use.name = &v.name;
+		add(v.type, use);
+	}
+}
+
+void UsageIndex::add(Cpp::Type &type, const Use &use)
+{
+	if (!type.isFundamentalType)
+		add(type.userType, use, 0);
+}
+
+void UsageIndex::add(Cpp::UserType *ut, const Use &use, int depth)
+{
+	std::vector<Use> &uses = m_uses[ut];
+
+	if (uses.empty())
+		m_typesByName[ut->name].push_back(ut);
+	else
+	{
+		// e.g. a function pointer with two parameters of the same type
+		const Use &last = uses.back();
+
+		if (last.kind == use.kind && last.file == use.file && last.ownerType == use.ownerType &&
+			last.ownerFunction == use.ownerFunction && last.name == use.name)
+			return;
+	}
+
+	uses.push_back(use);
+	m_useCount++;
+
+	// Array and function types can only refer back to themselves through
+	// malformed data, but don't follow them forever if they do
+	if (depth > 16)
+		return;
+
+	if (ut->type == Cpp::UserType::ARRAY)
+	{
+		if (!ut->arrayData->type.isFundamentalType)
+			add(ut->arrayData->type.userType, use, depth + 1);
+	}
+	else if (ut->type == Cpp::UserType::FUNCTION)
+	{
+		if (!ut->functionData->returnType.isFundamentalType)
+			add(ut->functionData->returnType.userType, use, depth + 1);
+
+		for (Cpp::FunctionType::Parameter &p : ut->functionData->parameters)
+		{
+			if (!p.type.isFundamentalType)
+				add(p.type.userType, use, depth + 1);
+		}
+	}
+}
+
+const std::vector<UsageIndex::Use> *UsageIndex::find(const Cpp::UserType *ut) const
+{
+	auto it = m_uses.find(ut);
+	return (it != m_uses.end()) ? &it->second : nullptr;
+}
+
+void UsageIndex::findByName(const std::string &name, std::vector<const Use*> *uses) const
+{
+	auto it = m_typesByName.find(name);
+
+	if (it == m_typesByName.end())
+		return;
+
+	for (const Cpp::UserType *ut : it->second)
+	{
+		const std::vector<Use> *typeUses = find(ut);
+
+		if (!typeUses)
+			continue;
+
+		for (const Use &use : *typeUses)
+			uses->push_back(&use);
+	}
+}
+
+bool UsageIndex::save(const std::string &path) const
+{
+	std::vector<const std::string*> names;
+	names.reserve(m_typesByName.size());
+
+	for (auto &entry : m_typesByName)
+		names.push_back(&entry.first);
+
+	std::sort(names.begin(), names.end(), [](const std::string *a, const std::string *b) {
+		return *a < *b;
+	});
+
+	std::ofstream file(path, std::ios::binary);
+	std::vector<const Use*> uses;
+	std::string out;
+
+	for (const std::string *name : names)
+	{
+		uses.clear();
+		findByName(*name, &uses);
+
+		for (const Use *use : uses)
+		{
+			out += *name;
+			out += '\t';
+			out += KindName(use->kind);
+			out += '\t';
+			out += use->file->filename;
+			out += '\t';
+			out += OwnerName(*use);
+			out += '\t';
+
+			if (use->name)
+				out += *use->name;
+
+			out += '\n';
+		}
+
+		if (out.size() >= (1 << 20))
+		{
+			file.write(out.data(), out.size());
+			out.clear();
+		}
+	}
+
+	file.write(out.data(), out.size());
+	file.close();
+
+	if (!file)
+	{
+		std::cout << "ERROR: Failed to write " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::string UsageIndex::OwnerName(const Use &use)
+{
+	if (use.ownerFunction)
+	{
+		if (use.ownerFunction->typeOwner)
+			return use.ownerFunction->typeOwner->name + "::" + use.ownerFunction->name;
+
+		return use.ownerFunction->name;
+	}
+
+	if (use.ownerType)
+		return use.ownerType->name;
+
+	return "";
+}
+
+const char *UsageIndex::KindName(Kind kind)
+{
+	switch (kind)
+	{
+	case BASE: return "base";
+	case MEMBER: return "member";
+	case VARIABLE: return "variable";
+	case RETURN: return "return";
+	case PARAMETER: return "parameter";
+	case LOCAL: return "local";
+	}
+
+	return "";
+}
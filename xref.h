@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cpp.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Every place a user type is referred to: base classes, members, variables,
+// function return types, parameters and locals. Built in one pass over the
+// model, for answering "what is affected if this type changes" without
+// searching the output.
+//
+// Uses through pointers and references count, as do uses through array and
+// function types, so a member "Base bases[3]" is a use of Base as well as of
+// the array type.
+class UsageIndex
+{
+public:
+	enum Kind { BASE, MEMBER, VARIABLE, RETURN, PARAMETER, LOCAL };
+
+	struct Use
+	{
+		Kind kind;
+		Cpp::File *file;
+
+		// The class or function the use is in, or neither for globals
+		Cpp::UserType *ownerType;
+		Cpp::Function *ownerFunction;
+
+		// Name of the member, variable, parameter or local, or nullptr
+		const std::string *name;
+	};
+
+	UsageIndex(const std::vector<Cpp::File*> &files);
+
+	// Returns nullptr if the type isn't used anywhere
+	const std::vector<Use> *find(const Cpp::UserType *ut) const;
+
+	// Uses of every type with that name; a type read from several compile
+	// units is a separate UserType in each
+	void findByName(const std::string &name, std::vector<const Use*> *uses) const;
+
+	inline size_t getUseCount() const
+	{
+		return m_useCount;
+	}
+
+	// Writes every use as a line of tab-separated type, kind, file, owner and
+	// name, sorted by type name
+	bool save(const std::string &path) const;
+
+	// e.g. "xEnt::Update", or "" for globals
+	static std::string OwnerName(const Use &use);
+	static const char *KindName(Kind kind);
+
+private:
+	std::unordered_map<const Cpp::UserType*, std::vector<Use>> m_uses;
+	std::unordered_map<std::string, std::vector<const Cpp::UserType*>> m_typesByName;
+	size_t m_useCount;
+
+	void addFunction(Cpp::File *file, Cpp::Function &function, Cpp::UserType *ownerType);
+	void add(Cpp::Type &type, const Use &use);
+	void add(Cpp::UserType *ut, const Use &use, int depth);
+};